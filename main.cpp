@@ -1,342 +1,6990 @@
 #include <iostream>
 #include <iomanip>            // std::setprecision, std::fixed 
+#include <fstream>            // export files
+#include <string>
+#include <string_view>
+#include <array>
+#include <vector>
+#include <deque>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <chrono>             // benchmark timing only
+#include <random>
+#include <functional>
+#include <cmath>
+#include <climits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <sstream>
+#include <coroutine>          // C++20: async gate API
+// POSIX/Linux networking for the metrics endpoint and gate server
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
 using namespace std;
 
 /*
  OOP Parking Lot Management System
  Data structures used:
-  - vector<Slot>             : store all slots (array-like)
-  - priority_queue<int,...>  : min-heaps (nearest free slot) per vehicle type
-  - unordered_map<string,int>: map vehicleID -> slot index (O(1))
-  - queue<WaitEntry>         : FIFO waitlist
+  - PagedVector<Slot>        : store all slots (array-like, copy-on-write pages for forks)
+  - SlotAllocator per slot type: free slots under the chosen strategy
+                               (free bitmap, lazy-deletion heaps, level tree)
+  - VehicleMap               : map vehicleID -> slot index (O(1), open addressing, paged)
+  - deque<WaitEntry>         : FIFO waitlist (deque so it can be walked without copying)
  Billing: user supplies duration in minutes at exit (no chrono).
 */
 
-// Vehicle types
-enum class VehicleType { CAR = 0, BIKE = 1, TRUCK = 2 };
+/* Built-in vehicle types, one line each:
+     X(NAME, default rate Rs/hr, slot type it parks in, bays, length m, width m, alias, alias)
+   A type whose slot type is itself owns a slot pool; the others park in
+   another type's slots (BUS across adjacent TRUCK slots, MOTORCYCLE in
+   BIKE slots). For slot-owning types the dimensions are the slot's; for the
+   rest they are the vehicle's. Sites can add or override classes at startup
+   through VehicleClassRegistry below without recompiling.
+*/
+#define PARKING_VEHICLE_TYPES(X)                                      \
+    X(CAR,          50.0, CAR,   1,  5.0, 2.5, "c", "car")            \
+    X(BIKE,         20.0, BIKE,  1,  2.2, 1.0, "b", "bike")           \
+    X(TRUCK,       100.0, TRUCK, 1, 12.0, 3.5, "t", "truck")          \
+    X(BUS,         150.0, TRUCK, 2, 24.0, 3.5, "",  "bus")            \
+    X(ARTICULATED, 200.0, TRUCK, 3, 36.0, 3.5, "a", "artic")          \
+    X(EV,           60.0, EV,    1,  5.0, 2.5, "e", "ev")             \
+    X(MOTORCYCLE,   25.0, BIKE,  1,  2.2, 1.0, "m", "moto")           \
+    X(VAN,          70.0, VAN,   1,  6.0, 2.5, "v", "van")
+
+// Built-in classes get fixed ordinals; runtime classes are numbered after them
+enum class VehicleType : uint8_t {
+#define PL_VEHICLE_ENUM(name, rate, slot, bays, len, wid, a1, a2) name,
+    PARKING_VEHICLE_TYPES(PL_VEHICLE_ENUM)
+#undef PL_VEHICLE_ENUM
+};
+
+struct VehicleTraits {
+    const char* name;
+    double defaultRate;
+    VehicleType slotType;
+    int bays;
+    double lengthM, widthM;
+    const char* alias1;
+    const char* alias2;
+};
+
+constexpr VehicleTraits kVehicleTraits[] = {
+#define PL_VEHICLE_TRAITS(name, rate, slot, bays, len, wid, a1, a2) {#name, rate, VehicleType::slot, bays, len, wid, a1, a2},
+    PARKING_VEHICLE_TYPES(PL_VEHICLE_TRAITS)
+#undef PL_VEHICLE_TRAITS
+};
+constexpr int kBuiltinVehicleTypes = (int)(sizeof(kVehicleTraits) / sizeof(kVehicleTraits[0]));
+
+// Upper bound on configured classes; every per-class array in the lot has this size
+constexpr int kMaxVehicleClasses = 32;
+
+// Every slot type must own its slots and every type needs at least one bay
+constexpr bool validVehicleTypeList() {
+    for (int i = 0; i < kBuiltinVehicleTypes; ++i) {
+        if (kVehicleTraits[i].bays < 1) return false;
+        if (kVehicleTraits[(int)kVehicleTraits[i].slotType].slotType != kVehicleTraits[i].slotType) return false;
+    }
+    return true;
+}
+static_assert(validVehicleTypeList(), "PARKING_VEHICLE_TYPES: slot types must park in themselves, bays >= 1");
+static_assert(kBuiltinVehicleTypes <= kMaxVehicleClasses, "raise kMaxVehicleClasses");
+
+/* ------------------ VehicleClassRegistry ------------------
+   Vehicle classes known to this process. Seeded with the built-in list,
+   then optionally extended or overridden from a config file at startup
+   (before any lot is created). Classes have dense ordinals, which are the
+   VehicleType values, so per-class pools and counters stay flat arrays.
+   classes_  : name, aliases, slot class, bays, default tariff, dimensions
+   keys_     : perfect hash of every lowercased name and alias -> ordinal;
+               seed_ is searched at build time so no two keys share a
+               bucket, making a lookup one hash and one compare
+
+   Config file, one class per line ('#' starts a comment):
+     name  slot-class  bays  rate  length  width  [alias ...]
+   slot-class is the class's own name for a new slot pool, or an existing
+   slot-owning class. bays 0 derives bays from length / slot length.
+   A line naming an existing class overrides it.
+*/
+struct VehicleClass {
+    string name;
+    vector<string> aliases;
+    VehicleType slotType = VehicleType::CAR;
+    int bays = 1;
+    double defaultRate = 0.0;
+    double lengthM = 0.0, widthM = 0.0;
+};
+
+class VehicleClassRegistry {
+private:
+    array<VehicleClass, kMaxVehicleClasses> classes_;
+    int count_ = 0;
+    VehicleType slotType_[kMaxVehicleClasses] = {};
+    int bays_[kMaxVehicleClasses] = {};
+    vector<pair<string, int>> keys_;   // bucket -> (key, ordinal); empty key = unused
+    uint64_t seed_ = 0;
+    uint64_t mask_ = 0;
+
+    static string lowered(const string &s) {
+        string out = s;
+        for (char &c : out) c = (char)tolower((unsigned char)c);
+        return out;
+    }
+
+    static uint64_t hashKey(const char *p, size_t n, uint64_t seed) {
+        uint64_t h = 1469598103934665603ULL ^ seed;
+        for (size_t i = 0; i < n; ++i) { h ^= (unsigned char)p[i]; h *= 1099511628211ULL; }
+        return h ^ (h >> 29);
+    }
+
+    // Build the collision-free table; fails only on a duplicate key
+    bool buildHash(string &err) {
+        for (int i = 0; i < count_; ++i) {
+            slotType_[i] = classes_[i].slotType;
+            bays_[i] = classes_[i].bays;
+        }
+        vector<pair<string, int>> all;
+        for (int i = 0; i < count_; ++i) {
+            all.push_back({lowered(classes_[i].name), i});
+            for (const auto &a : classes_[i].aliases)
+                if (!a.empty()) all.push_back({lowered(a), i});
+        }
+        sort(all.begin(), all.end());
+        for (size_t i = 1; i < all.size(); ++i) {
+            if (all[i].first == all[i - 1].first && all[i].second != all[i - 1].second) {
+                err = "name/alias '" + all[i].first + "' used by both " + classes_[all[i - 1].second].name
+                    + " and " + classes_[all[i].second].name;
+                return false;
+            }
+        }
+        all.erase(unique(all.begin(), all.end()), all.end());
+        size_t size = 16;
+        while (size < all.size() * 2) size <<= 1;
+        for (;; size <<= 1) {
+            for (uint64_t seed = 1; seed <= 4096; ++seed) {
+                vector<pair<string, int>> table(size, {string(), -1});
+                bool ok = true;
+                for (const auto &kv : all) {
+                    auto &b = table[hashKey(kv.first.data(), kv.first.size(), seed) & (size - 1)];
+                    if (!b.first.empty()) { ok = false; break; }
+                    b = kv;
+                }
+                if (!ok) continue;
+                keys_.swap(table);
+                seed_ = seed;
+                mask_ = size - 1;
+                return true;
+            }
+        }
+    }
+
+    int add(const VehicleClass &c) {
+        classes_[count_] = c;
+        return count_++;
+    }
+
+public:
+    VehicleClassRegistry() {
+        for (int i = 0; i < kBuiltinVehicleTypes; ++i) {
+            const VehicleTraits &t = kVehicleTraits[i];
+            VehicleClass c;
+            c.name = t.name;
+            if (t.alias1[0]) c.aliases.push_back(t.alias1);
+            if (t.alias2[0]) c.aliases.push_back(t.alias2);
+            c.slotType = t.slotType;
+            c.bays = t.bays;
+            c.defaultRate = t.defaultRate;
+            c.lengthM = t.lengthM;
+            c.widthM = t.widthM;
+            add(c);
+        }
+        string err;
+        buildHash(err);
+    }
+
+    static VehicleClassRegistry& instance();
+
+    int count() const { return count_; }
+    const VehicleClass& at(VehicleType vt) const { return classes_[(int)vt]; }
+
+    // Hot-path fields kept in their own small arrays
+    VehicleType slotTypeOf(VehicleType vt) const { return slotType_[(int)vt]; }
+    int baysOf(VehicleType vt) const { return bays_[(int)vt]; }
+
+    // Ordinal for a name or alias (case-insensitive), -1 if unknown
+    int find(const string &s) const {
+        char buf[64];
+        size_t n = s.size();
+        if (n == 0 || n > sizeof(buf)) return -1;
+        for (size_t i = 0; i < n; ++i) buf[i] = (char)tolower((unsigned char)s[i]);
+        const auto &b = keys_[hashKey(buf, n, seed_) & mask_];
+        if (b.second < 0 || b.first.size() != n || memcmp(b.first.data(), buf, n) != 0) return -1;
+        return b.second;
+    }
+
+    // Load classes from a config file; on any error nothing changes
+    bool loadFile(const string &path, string &err) {
+        ifstream in(path);
+        if (!in) { err = "cannot open " + path; return false; }
+        auto savedClasses = classes_;
+        int savedCount = count_;
+        auto fail = [&](int lineNo, const string &msg) {
+            classes_ = savedClasses;
+            count_ = savedCount;
+            err = path + ":" + to_string(lineNo) + ": " + msg;
+            return false;
+        };
+        string line;
+        int lineNo = 0;
+        while (getline(in, line)) {
+            ++lineNo;
+            size_t hashPos = line.find('#');
+            if (hashPos != string::npos) line.resize(hashPos);
+            istringstream ls(line);
+            VehicleClass c;
+            string slotName;
+            if (!(ls >> c.name)) continue;
+            if (!(ls >> slotName >> c.bays >> c.defaultRate >> c.lengthM >> c.widthM))
+                return fail(lineNo, "expected: name slot-class bays rate length width [alias ...]");
+            for (string a; ls >> a; ) c.aliases.push_back(a);
+            for (char &ch : c.name) ch = (char)toupper((unsigned char)ch);
+            if (c.bays < 0 || c.defaultRate < 0 || c.lengthM <= 0 || c.widthM <= 0)
+                return fail(lineNo, "bays, rate and dimensions must be non-negative (dimensions > 0)");
+
+            int existing = -1;
+            for (int i = 0; i < count_; ++i) if (lowered(classes_[i].name) == lowered(c.name)) existing = i;
+            int ord = existing >= 0 ? existing : count_;
+            if (existing < 0 && count_ >= kMaxVehicleClasses)
+                return fail(lineNo, "too many vehicle classes (max " + to_string(kMaxVehicleClasses) + ")");
+
+            int slotOrd = -1;
+            if (lowered(slotName) == lowered(c.name)) slotOrd = ord;
+            else for (int i = 0; i < count_; ++i) if (lowered(classes_[i].name) == lowered(slotName)) slotOrd = i;
+            if (slotOrd < 0) return fail(lineNo, "unknown slot class '" + slotName + "'");
+            if (slotOrd != ord && (int)classes_[slotOrd].slotType != slotOrd)
+                return fail(lineNo, "'" + slotName + "' does not own slots");
+            if (existing >= 0 && slotOrd != ord && (int)classes_[existing].slotType == existing) {
+                for (int i = 0; i < count_; ++i)
+                    if (i != existing && (int)classes_[i].slotType == existing)
+                        return fail(lineNo, c.name + " has dependent classes and must keep its own slots");
+            }
+            c.slotType = (VehicleType)slotOrd;
+            if (c.bays == 0) {
+                double slotLen = slotOrd == ord ? c.lengthM : classes_[slotOrd].lengthM;
+                c.bays = max(1, (int)ceil(c.lengthM / slotLen - 1e-9));
+            }
+            if (existing >= 0 && c.aliases.empty()) c.aliases = classes_[existing].aliases;
+            if (existing >= 0) classes_[existing] = c;
+            else add(c);
+        }
+        string hashErr;
+        if (!buildHash(hashErr)) return fail(lineNo, hashErr);
+        return true;
+    }
+
+    void display() const {
+        cout << "\n🚙 Vehicle classes (" << count_ << "):\n";
+        for (int i = 0; i < count_; ++i) {
+            const VehicleClass &c = classes_[i];
+            cout << "  #" << i << " " << c.name << " | slot: " << classes_[(int)c.slotType].name
+                 << " | bays: " << c.bays << " | Rs " << fixed << setprecision(2) << c.defaultRate << "/hr"
+                 << " | " << setprecision(1) << c.lengthM << "m x " << c.widthM << "m";
+            if (!c.aliases.empty()) {
+                cout << " | aliases:";
+                for (const auto &a : c.aliases) cout << " " << a;
+            }
+            cout << "\n";
+        }
+    }
+};
+
+// Process-wide registry; a plain global so hot-path lookups skip the
+// function-local static guard
+static VehicleClassRegistry g_vehicleClasses;
+VehicleClassRegistry& VehicleClassRegistry::instance() { return g_vehicleClasses; }
+
+// Number of configured vehicle classes
+inline int vehicleClassCount() { return g_vehicleClasses.count(); }
+
+// Helper to convert enum to printable string
+static string vehicleTypeToStr(VehicleType vt) { return VehicleClassRegistry::instance().at(vt).name; }
+
+// Slot type a vehicle parks in
+inline VehicleType slotTypeFor(VehicleType vt) { return g_vehicleClasses.slotTypeOf(vt); }
+
+// Number of adjacent slots (bays) a vehicle occupies
+inline int baysFor(VehicleType vt) { return g_vehicleClasses.baysOf(vt); }
+
+// Whether this type has its own slots (and hence a free pool)
+inline bool ownsSlots(VehicleType vt) { return slotTypeFor(vt) == vt; }
+
+// One value per vehicle class
+template <typename T>
+constexpr array<T, kMaxVehicleClasses> perVehicleType(T value) {
+    array<T, kMaxVehicleClasses> a{};
+    for (auto &x : a) x = value;
+    return a;
+}
+
+static array<double, kMaxVehicleClasses> defaultRates() {
+    array<double, kMaxVehicleClasses> a{};
+    for (int i = 0; i < vehicleClassCount(); ++i) a[i] = VehicleClassRegistry::instance().at((VehicleType)i).defaultRate;
+    return a;
+}
+
+/* ------------------ PagedVector ------------------
+   Vector stored as fixed pages of 2^kPageBits elements, each page
+   reference counted. Copying one copies only the page table; a page is
+   cloned the first time a copy writes to it (mut), so forked lots share
+   every page neither side has touched. Reads are one extra indirection.
+   A copy may be handed to another thread: a page is written only by its
+   sole owner, and the count is read with acquire so the owner sees every
+   clone of it finish before it writes.
+*/
+template <typename T, int kPageBits = 12>
+class PagedVector {
+public:
+    static const size_t kPage = size_t(1) << kPageBits;
+
+private:
+    struct Block {
+        atomic<long> refs{1};
+        T items[kPage];
+    };
+
+    // Counted reference to one page
+    class Page {
+        Block* b_ = nullptr;
+    public:
+        Page() = default;
+        explicit Page(Block* b) : b_(b) {}
+        Page(const Page& o) : b_(o.b_) { if (b_) b_->refs.fetch_add(1, memory_order_relaxed); }
+        Page(Page&& o) noexcept : b_(o.b_) { o.b_ = nullptr; }
+        Page& operator=(Page o) noexcept { swap(b_, o.b_); return *this; }
+        ~Page() { if (b_ && b_->refs.fetch_sub(1, memory_order_acq_rel) == 1) delete b_; }
+        T* get() const { return b_->items; }
+        bool unique() const { return b_->refs.load(memory_order_acquire) == 1; }
+        bool shared() const { return b_->refs.load(memory_order_relaxed) > 1; }
+    };
+
+    vector<Page> pages_;
+    size_t size_ = 0;
+
+    static Page filled(const T& v) {
+        Page p(new Block);
+        std::fill(p.get(), p.get() + kPage, v);
+        return p;
+    }
+
+    T* own(size_t p) {
+        Page &pg = pages_[p];
+        if (!pg.unique()) {
+            Page copy(new Block);
+            std::copy(pg.get(), pg.get() + kPage, copy.get());
+            pg = move(copy);
+        }
+        return pg.get();
+    }
+
+public:
+    // Walks a page by pointer; the page table is consulted once per page
+    class const_iterator {
+        const PagedVector* v_;
+        size_t i_;
+        const T* p_ = nullptr;
+        void load() { if (i_ < v_->size_) p_ = v_->pages_[i_ >> kPageBits].get() + (i_ & (kPage - 1)); }
+    public:
+        const_iterator(const PagedVector* v, size_t i) : v_(v), i_(i) { load(); }
+        const T& operator*() const { return *p_; }
+        const T* operator->() const { return p_; }
+        const_iterator& operator++() {
+            if (++i_ & (kPage - 1)) ++p_;
+            else load();
+            return *this;
+        }
+        bool operator!=(const const_iterator& o) const { return i_ != o.i_; }
+    };
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size_); }
+
+    const T& operator[](size_t i) const { return pages_[i >> kPageBits].get()[i & (kPage - 1)]; }
+    const T& back() const { return (*this)[size_ - 1]; }
+    T& mut(size_t i) { return own(i >> kPageBits)[i & (kPage - 1)]; }
+
+    void clear() { pages_.clear(); size_ = 0; }
+    void reserve(size_t n) { pages_.reserve((n + kPage - 1) / kPage); }
+
+    // Grow (new elements = v) or shrink. New whole pages start as one
+    // shared page of v, split off as they are written.
+    void resize(size_t n, const T& v = T()) {
+        for (size_t i = size_; i < n && (i & (kPage - 1)); ++i) mut(i) = v;   // tail of the last page
+        size_t from = (size_ + kPage - 1) / kPage;
+        pages_.resize((n + kPage - 1) / kPage);
+        if (from < pages_.size()) {
+            Page fill = filled(v);
+            for (size_t p = from; p < pages_.size(); ++p) pages_[p] = fill;
+        }
+        size_ = n;
+    }
+    void assign(size_t n, const T& v) { clear(); resize(n, v); }
+
+    void push_back(T v) {
+        if (size_ == pages_.size() * kPage) pages_.push_back(Page(new Block));
+        mut(size_++) = move(v);
+    }
+    template <typename... Args>
+    void emplace_back(Args&&... args) { push_back(T(std::forward<Args>(args)...)); }
+    void pop_back() { --size_; }
+
+    // Pages currently shared with another copy (diagnostics)
+    size_t sharedPages() const {
+        size_t n = 0;
+        for (const auto &p : pages_) n += p.shared();
+        return n;
+    }
+    size_t pageCount() const { return pages_.size(); }
+};
+
+/* ------------------ CowBox ------------------
+   A value shared between copies until one of them writes (mut clones it).
+   For bounded-size state (statistics, forecasts) that forks rarely touch;
+   a one-element PagedVector.
+*/
+template <typename T>
+class CowBox {
+private:
+    PagedVector<T, 0> v_;
+public:
+    CowBox() { v_.resize(1); }
+    const T& operator*() const { return v_[0]; }
+    const T* operator->() const { return &v_[0]; }
+    T& mut() { return v_.mut(0); }
+};
+
+/* ------------------ VehicleMap ------------------
+   vehicleID -> slot index, open addressing with linear probing over a
+   PagedVector, so a forked lot shares the table pages it has not touched.
+   Erase shifts the following cluster back (no tombstones). A position
+   (locate) stays valid until the next set or erase.
+*/
+class VehicleMap {
+public:
+    static const size_t npos = SIZE_MAX;
+
+private:
+    struct Entry {
+        string id;
+        int slot = -1;   // -1 = empty
+    };
+    PagedVector<Entry> table_;
+    size_t size_ = 0;
+    size_t mask_ = 0;
+
+    size_t home(const string& id) const { return hash<string>{}(id) & mask_; }
+
+    void grow() {
+        PagedVector<Entry> old = move(table_);
+        table_ = PagedVector<Entry>();
+        table_.resize(max<size_t>(64, old.size() * 2));
+        mask_ = table_.size() - 1;
+        for (const auto &e : old) {
+            if (e.slot < 0) continue;
+            size_t i = home(e.id);
+            while (table_[i].slot >= 0) i = (i + 1) & mask_;
+            table_.mut(i) = e;
+        }
+    }
+
+public:
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    void clear() { table_.clear(); size_ = 0; mask_ = 0; }
+
+    size_t locate(const string& id) const {
+        if (table_.empty()) return npos;
+        for (size_t i = home(id); ; i = (i + 1) & mask_) {
+            const Entry &e = table_[i];
+            if (e.slot < 0) return npos;
+            if (e.id == id) return i;
+        }
+    }
+    int slotAt(size_t pos) const { return table_[pos].slot; }
+    int slotOf(const string& id) const {
+        size_t pos = locate(id);
+        return pos == npos ? -1 : table_[pos].slot;
+    }
+    size_t count(const string& id) const { return locate(id) != npos; }
+
+    void set(const string& id, int slot) {
+        if ((size_ + 1) * 4 > table_.size() * 3) grow();
+        size_t i = home(id);
+        while (table_[i].slot >= 0 && table_[i].id != id) i = (i + 1) & mask_;
+        Entry &e = table_.mut(i);
+        if (e.slot < 0) { e.id = id; ++size_; }
+        e.slot = slot;
+    }
+
+    void eraseAt(size_t pos) {
+        size_t hole = pos;
+        for (size_t i = (pos + 1) & mask_; table_[i].slot >= 0; i = (i + 1) & mask_) {
+            size_t h = home(table_[i].id);
+            // move i back into the hole unless its home lies cyclically in (hole, i]
+            if (((i - h) & mask_) >= ((i - hole) & mask_)) {
+                table_.mut(hole) = move(table_.mut(i));
+                hole = i;
+            }
+        }
+        Entry &e = table_.mut(hole);
+        e.slot = -1;
+        e.id.clear();
+        --size_;
+    }
+    bool erase(const string& id) {
+        size_t pos = locate(id);
+        if (pos == npos) return false;
+        eraseAt(pos);
+        return true;
+    }
+
+    template <typename F>
+    void forEach(F f) const {
+        for (const auto &e : table_) if (e.slot >= 0) f(e.id, e.slot);
+    }
+};
+
+/* ------------------ PlateIndex ------------------
+   Sorted suffix index over parked plates, for lookups by part of a plate.
+   Every suffix of every plate is one key and keys are kept in order of
+   their text, so the plates containing a fragment are the run of keys
+   that start with it. Whole plates (offset 0) and proper suffixes are
+   kept in separate runs: a prefix search reads only the first, and prefix
+   matches come first in a substring search.
+   A key carries its first 7 characters and length packed into an integer
+   (head), so most comparisons never touch the plate text. Keys live in
+   sorted blocks of up to kBlockKeys, found through a fence list of each
+   block's first key; a full block splits and a sparse one merges with
+   its successor, so insert and erase move at most one block. Plates,
+   blocks and the id map are paged, so forks share the index
+   copy-on-write; only the fence lists are copied.
+*/
+class PlateIndex {
+public:
+    static const int kBlockKeys = 128;
+    static const size_t kMaxOffset = 255;   // suffixes past this offset are not indexed
+
+private:
+    struct Key {
+        uint64_t head = 0;   // 7 characters (zero padded), then min(length, 8)
+        uint64_t ref = 0;    // plate id << 8 | offset
+    };
+    struct Block {
+        int n = 0;
+        Key keys[kBlockKeys];
+    };
+    struct Fence {
+        Key first;
+        uint32_t block = 0;
+    };
+    PagedVector<string> plates_;          // by id; empty = unused id
+    PagedVector<uint32_t> freeIds_;
+    VehicleMap ids_;                      // plate -> id
+    PagedVector<Block, 3> blocks_;
+    PagedVector<uint32_t> freeBlocks_;
+    vector<Fence> order_[2];              // blocks in key order: whole plates, proper suffixes
+
+    string_view text(uint64_t ref) const { return string_view(plates_[ref >> 8]).substr(ref & 255); }
+
+    Key keyOf(uint64_t ref) const {
+        string_view t = text(ref);
+        uint64_t h = 0;
+        for (size_t i = 0; i < 7; ++i) h = h << 8 | (i < t.size() ? (unsigned char)t[i] : 0);
+        return Key{h << 8 | min<size_t>(t.size(), 8), ref};
+    }
+    // Equal heads of length 8 share 7 characters but may differ after them
+    bool less(const Key& a, const Key& b) const {
+        if (a.head != b.head) return a.head < b.head;
+        if ((a.head & 255) == 8) {
+            int c = text(a.ref).compare(text(b.ref));
+            if (c) return c < 0;
+        }
+        return a.ref < b.ref;
+    }
+    static int runOf(uint64_t ref) { return (ref & 255) ? 1 : 0; }
+
+    uint32_t newBlock() {
+        if (freeBlocks_.empty()) {
+            blocks_.push_back(Block{});
+            return (uint32_t)blocks_.size() - 1;
+        }
+        uint32_t b = freeBlocks_.back();
+        freeBlocks_.pop_back();
+        blocks_.mut(b).n = 0;
+        return b;
+    }
+
+    // Position in order of the block that holds (or would hold) key
+    size_t blockFor(const vector<Fence>& order, const Key& key) const {
+        auto it = upper_bound(order.begin(), order.end(), key, [&](const Key& k, const Fence& f) { return less(k, f.first); });
+        return it == order.begin() ? 0 : it - order.begin() - 1;
+    }
+
+    void insertKey(const Key& key) {
+        vector<Fence> &order = order_[runOf(key.ref)];
+        if (order.empty()) order.push_back(Fence{key, newBlock()});
+        size_t i = blockFor(order, key);
+        if (blocks_[order[i].block].n == kBlockKeys) {
+            uint32_t nb = newBlock();
+            Block &a = blocks_.mut(order[i].block), &z = blocks_.mut(nb);
+            const int half = kBlockKeys / 2;
+            copy(a.keys + half, a.keys + kBlockKeys, z.keys);
+            z.n = kBlockKeys - half;
+            a.n = half;
+            order.insert(order.begin() + i + 1, Fence{z.keys[0], nb});
+            if (!less(key, z.keys[0])) ++i;
+        }
+        Block &bl = blocks_.mut(order[i].block);
+        Key* at = lower_bound(bl.keys, bl.keys + bl.n, key, [&](const Key& x, const Key& y) { return less(x, y); });
+        copy_backward(at, bl.keys + bl.n, bl.keys + bl.n + 1);
+        *at = key;
+        ++bl.n;
+        order[i].first = bl.keys[0];
+    }
+
+    void eraseKey(const Key& key) {
+        vector<Fence> &order = order_[runOf(key.ref)];
+        if (order.empty()) return;
+        size_t i = blockFor(order, key);
+        Block &bl = blocks_.mut(order[i].block);
+        Key* at = lower_bound(bl.keys, bl.keys + bl.n, key, [&](const Key& x, const Key& y) { return less(x, y); });
+        if (at == bl.keys + bl.n || at->ref != key.ref) return;
+        copy(at + 1, bl.keys + bl.n, at);
+        --bl.n;
+        if (bl.n == 0) {
+            freeBlocks_.push_back(order[i].block);
+            order.erase(order.begin() + i);
+            return;
+        }
+        order[i].first = bl.keys[0];
+        if (i + 1 < order.size() && bl.n + blocks_[order[i + 1].block].n <= kBlockKeys / 2) {
+            const Block &next = blocks_[order[i + 1].block];
+            copy(next.keys, next.keys + next.n, bl.keys + bl.n);
+            bl.n += next.n;
+            freeBlocks_.push_back(order[i + 1].block);
+            order.erase(order.begin() + i + 1);
+        }
+    }
+
+    uint32_t newId(const string& plate) {
+        uint32_t id;
+        if (freeIds_.empty()) {
+            id = (uint32_t)plates_.size();
+            plates_.push_back(plate);
+        } else {
+            id = freeIds_.back();
+            freeIds_.pop_back();
+            plates_.mut(id) = plate;
+        }
+        ids_.set(plate, (int)id);
+        return id;
+    }
+
+    static size_t suffixCount(const string& plate) { return min(plate.size(), kMaxOffset + 1); }
+
+    // Append the plates of one run's keys that start with q to out (distinct, up to limit)
+    void collect(int run, string_view q, size_t limit, unordered_set<uint32_t>& seen, vector<string>& out) const {
+        const vector<Fence> &order = order_[run];
+        // the matches may begin inside the last block whose first key sorts before q
+        size_t i = lower_bound(order.begin(), order.end(), q,
+                               [&](const Fence& f, string_view v) { return text(f.first.ref) < v; }) - order.begin();
+        if (i > 0) --i;
+        for (; i < order.size(); ++i) {
+            const Block &bl = blocks_[order[i].block];
+            const Key* at = lower_bound(bl.keys, bl.keys + bl.n, q, [&](const Key& k, string_view v) { return text(k.ref) < v; });
+            for (; at != bl.keys + bl.n; ++at) {
+                if (text(at->ref).substr(0, q.size()) != q) return;
+                uint32_t id = uint32_t(at->ref >> 8);
+                if (!seen.insert(id).second) continue;
+                out.push_back(plates_[id]);
+                if (out.size() >= limit) return;
+            }
+        }
+    }
+
+public:
+    size_t size() const { return ids_.size(); }
+    bool contains(const string& plate) const { return ids_.count(plate) != 0; }
+
+    void clear() {
+        plates_.clear(); freeIds_.clear(); ids_.clear();
+        blocks_.clear(); freeBlocks_.clear();
+        order_[0].clear(); order_[1].clear();
+    }
+
+    // Index the given plates from scratch: sort every key once and fill
+    // blocks three-quarters full, leaving room for entries before a split
+    void build(const vector<string>& plates) {
+        clear();
+        vector<Key> keys[2];
+        for (const auto &p : plates) {
+            if (p.empty() || ids_.count(p)) continue;
+            uint64_t id = newId(p);
+            for (size_t off = 0; off < suffixCount(p); ++off) keys[off ? 1 : 0].push_back(keyOf(id << 8 | off));
+        }
+        for (int run = 0; run < 2; ++run) {
+            sort(keys[run].begin(), keys[run].end(), [&](const Key& a, const Key& b) { return less(a, b); });
+            const size_t fill = kBlockKeys * 3 / 4;
+            for (size_t from = 0; from < keys[run].size(); from += fill) {
+                uint32_t b = newBlock();
+                Block &bl = blocks_.mut(b);
+                bl.n = (int)min(fill, keys[run].size() - from);
+                copy(keys[run].begin() + from, keys[run].begin() + from + bl.n, bl.keys);
+                order_[run].push_back(Fence{bl.keys[0], b});
+            }
+        }
+    }
+
+    void insert(const string& plate) {
+        if (plate.empty() || ids_.count(plate)) return;
+        uint64_t id = newId(plate);
+        for (size_t off = 0; off < suffixCount(plate); ++off) insertKey(keyOf(id << 8 | off));
+    }
+
+    void erase(const string& plate) {
+        int found = ids_.slotOf(plate);
+        if (found < 0) return;
+        uint64_t id = (uint64_t)found;
+        for (size_t off = 0; off < suffixCount(plate); ++off) eraseKey(keyOf(id << 8 | off));
+        ids_.erase(plate);
+        plates_.mut(id).clear();
+        freeIds_.push_back((uint32_t)id);
+    }
+
+    // Up to limit plates starting with fragment, in plate order; unless
+    // prefixOnly, followed by plates containing it elsewhere
+    vector<string> search(const string& fragment, bool prefixOnly, size_t limit) const {
+        vector<string> out;
+        if (fragment.empty() || limit == 0) return out;
+        unordered_set<uint32_t> seen;
+        collect(0, fragment, limit, seen, out);
+        if (!prefixOnly && out.size() < limit) collect(1, fragment, limit, seen, out);
+        return out;
+    }
+};
+
+/* ------------------ PlateMatcher ------------------
+   Fuzzy index over parked plates for camera misreads. Plates are folded
+   to an OCR form (upper case; O/D/Q -> 0, B -> 8, I -> 1, S -> 5, Z -> 2,
+   G -> 6), so a misread made only of such confusions lands on the same
+   key. Keys form a BK-tree under plain edit distance: a query d edits from
+   a node only needs the children whose edge distance lies in [d - r, d + r]
+   to find every key within r edits. Matches are ranked by ocrDistance() on
+   the plates as read: a confusable substitution costs 0.25, any other
+   edit 1. Keys made only of confusions (r = 0) skip the tree for the key
+   map. An exit leaves its key in place as a routing node; the tree is
+   rebuilt once empty nodes outnumber plates. Nodes, edges and the key map
+   are paged, so forks share the tree copy-on-write.
+*/
+class PlateMatcher {
+public:
+    struct Candidate {
+        string plate;
+        double distance = 0.0;
+    };
+
+private:
+    struct Node {
+        string key;
+        vector<string> plates;           // parked plates folding to key, usually one
+    };
+    // Tree edges apart from the nodes, so scanning a node's children
+    // touches 12 bytes per child
+    struct Link {
+        int dist = 0;                    // edit distance to the parent's key
+        int firstChild = -1, nextSibling = -1;
+    };
+    PagedVector<Node, 10> nodes_;        // root = 0
+    PagedVector<Link> links_;            // by node
+    VehicleMap keys_;                    // key -> node
+    size_t plates_ = 0;
+    size_t emptyNodes_ = 0;
+
+    static char fold(char c) {
+        c = (char)toupper((unsigned char)c);
+        switch (c) {
+            case 'O': case 'D': case 'Q': return '0';
+            case 'B': return '8';
+            case 'I': return '1';
+            case 'S': return '5';
+            case 'Z': return '2';
+            case 'G': return '6';
+            default: return c;
+        }
+    }
+public:
+    // OCR form of a plate: equal for plates that differ only by confusions
+    static string folded(const string& plate) {
+        string k(plate);
+        for (char &c : k) c = fold(c);
+        return k;
+    }
+
+private:
+
+    /* Levenshtein distance from one key to many: Myers' bit-parallel
+       algorithm with the key as the pattern, one word op per column, for
+       keys up to 64 characters; longer ones fall back to two DP rows. */
+    class Distance {
+        string p_;
+        uint64_t peq_[256] = {};
+    public:
+        explicit Distance(const string& pattern) : p_(pattern) {
+            for (size_t i = 0; i < p_.size() && i < 64; ++i) peq_[(unsigned char)p_[i]] |= 1ULL << i;
+        }
+        int to(const string& t) const {
+            size_t m = p_.size();
+            if (m == 0) return (int)t.size();
+            if (m > 64) return slow(t);
+            uint64_t pv = m == 64 ? ~0ULL : (1ULL << m) - 1, mv = 0, high = 1ULL << (m - 1);
+            int score = (int)m;
+            for (unsigned char c : t) {
+                uint64_t eq = peq_[c], xv = eq | mv;
+                uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+                uint64_t ph = mv | ~(xh | pv), mh = pv & xh;
+                if (ph & high) ++score;
+                else if (mh & high) --score;
+                ph = ph << 1 | 1;   // row 0 grows by one per column
+                mh <<= 1;
+                pv = mh | ~(xv | ph);
+                mv = ph & xv;
+            }
+            return score;
+        }
+        int slow(const string& t) const {
+            vector<int> prev(t.size() + 1), cur(t.size() + 1);
+            for (size_t j = 0; j <= t.size(); ++j) prev[j] = (int)j;
+            for (size_t i = 1; i <= p_.size(); ++i) {
+                cur[0] = (int)i;
+                for (size_t j = 1; j <= t.size(); ++j)
+                    cur[j] = min(min(prev[j] + 1, cur[j - 1] + 1), prev[j - 1] + (p_[i - 1] != t[j - 1]));
+                swap(prev, cur);
+            }
+            return prev[t.size()];
+        }
+    };
+
+    void link(int id) {
+        Distance dist(nodes_[id].key);
+        for (int cur = 0;;) {
+            int d = dist.to(nodes_[cur].key);
+            int child = links_[cur].firstChild;
+            while (child >= 0 && links_[child].dist != d) child = links_[child].nextSibling;
+            if (child >= 0) { cur = child; continue; }
+            Link &l = links_.mut(id);
+            l.dist = d;
+            l.nextSibling = links_[cur].firstChild;
+            links_.mut(cur).firstChild = id;
+            return;
+        }
+    }
+
+    void rebuild() {
+        vector<string> live;
+        live.reserve(plates_);
+        for (const auto &n : nodes_) live.insert(live.end(), n.plates.begin(), n.plates.end());
+        build(live);
+    }
+
+public:
+    // Weighted edit distance between two plates as read (see banner)
+    static double ocrDistance(const string& a, const string& b) {
+        vector<double> prev(b.size() + 1), cur(b.size() + 1);
+        for (size_t j = 0; j <= b.size(); ++j) prev[j] = (double)j;
+        for (size_t i = 1; i <= a.size(); ++i) {
+            cur[0] = (double)i;
+            for (size_t j = 1; j <= b.size(); ++j) {
+                char x = a[i - 1], y = b[j - 1];
+                double sub = toupper((unsigned char)x) == toupper((unsigned char)y) ? 0.0 : fold(x) == fold(y) ? 0.25 : 1.0;
+                cur[j] = min(min(prev[j] + 1, cur[j - 1] + 1), prev[j - 1] + sub);
+            }
+            swap(prev, cur);
+        }
+        return prev[b.size()];
+    }
+
+    size_t size() const { return plates_; }
+
+    void clear() { nodes_.clear(); links_.clear(); keys_.clear(); plates_ = emptyNodes_ = 0; }
+
+    void build(const vector<string>& plates) {
+        clear();
+        for (const auto &p : plates) insert(p);
+    }
+
+    void insert(const string& plate) {
+        string key = folded(plate);
+        int found = keys_.slotOf(key);
+        if (found >= 0) {
+            Node &n = nodes_.mut(found);
+            if (find(n.plates.begin(), n.plates.end(), plate) != n.plates.end()) return;
+            if (n.plates.empty()) --emptyNodes_;
+            n.plates.push_back(plate);
+            ++plates_;
+            return;
+        }
+        int id = (int)nodes_.size();
+        Node n;
+        n.key = key;
+        n.plates.push_back(plate);
+        nodes_.push_back(move(n));
+        links_.push_back(Link{});
+        keys_.set(key, id);
+        ++plates_;
+        if (id > 0) link(id);
+    }
+
+    void erase(const string& plate) {
+        int found = keys_.slotOf(folded(plate));
+        if (found < 0) return;
+        Node &n = nodes_.mut(found);
+        auto it = find(n.plates.begin(), n.plates.end(), plate);
+        if (it == n.plates.end()) return;
+        n.plates.erase(it);
+        --plates_;
+        if (n.plates.empty() && ++emptyNodes_ > max<size_t>(plates_, 64)) rebuild();
+    }
+
+    // Every parked plate that differs from read only by confusions (the
+    // plates of its key's node), however many confusions that takes
+    vector<string> sameKey(const string& read) const {
+        int found = keys_.slotOf(folded(read));
+        return found < 0 ? vector<string>() : nodes_[found].plates;
+    }
+
+    // Parked plates within maxDistance of a plate as read, nearest first
+    // (ties by plate), at most limit
+    vector<Candidate> match(const string& read, double maxDistance, size_t limit) const {
+        vector<Candidate> out;
+        if (nodes_.empty() || limit == 0) return out;
+        string key = folded(read);
+        int r = (int)maxDistance;          // confusions cost no edits once folded
+        auto take = [&](const Node& n) {
+            for (const auto &p : n.plates) {
+                double d = ocrDistance(read, p);
+                if (d <= maxDistance) out.push_back(Candidate{p, d});
+            }
+        };
+        if (r == 0) {
+            int found = keys_.slotOf(key);
+            if (found >= 0) take(nodes_[found]);
+        } else {
+            Distance dist(key);
+            vector<int> todo{0};
+            while (!todo.empty()) {
+                int at = todo.back();
+                todo.pop_back();
+                const Node &n = nodes_[at];
+                int d = dist.to(n.key);
+                if (d <= r) take(n);
+                for (int c = links_[at].firstChild; c >= 0; c = links_[c].nextSibling)
+                    if (abs(links_[c].dist - d) <= r) todo.push_back(c);
+            }
+        }
+        sort(out.begin(), out.end(), [](const Candidate& a, const Candidate& b) {
+            return a.distance != b.distance ? a.distance < b.distance : a.plate < b.plate;
+        });
+        if (out.size() > limit) out.resize(limit);
+        return out;
+    }
+};
+
+/* ------------------ Ticket ------------------
+   Simple POD representing a parking ticket.
+   id       : generated ticket id (e.g. "T1")
+   vehicleID: registration or unique id provided by user
+   vtype    : vehicle type
+   slotIndex: internal 0-based index of assigned slot (first bay)
+   bays     : number of adjacent slots held, starting at slotIndex
+*/
+class Ticket {
+public:
+    string id;
+    string vehicleID;
+    VehicleType vtype;
+    int slotIndex; // internal 0-based index
+    int bays = 1;
+
+    Ticket() = default;
+    // Accept by const-ref for clarity and safety (no moves required)
+    Ticket(const string& tid, const string& vid, VehicleType vt, int idx)
+        : id(tid), vehicleID(vid), vtype(vt), slotIndex(idx), bays(baysFor(vt)) {}
+};
+
+/* ------------------ Slot ------------------
+   Represents one parking slot.
+   index_   : 0-based slot index
+   type_    : allowed vehicle type for this slot
+   occupied_: whether slot is occupied
+   closed_  : decommissioned; never handed out again (an occupied closed
+              slot is draining and leaves service when its vehicle exits)
+   ticket_  : ticket info when occupied, shared by every bay of a
+              multi-bay vehicle (keeps free slots at 24 bytes)
+*/
+class Slot {
+private:
+    int index_ = 0;
+    VehicleType type_ = VehicleType::CAR;
+    bool occupied_ = false;
+    bool closed_ = false;
+    shared_ptr<const Ticket> ticket_; // set only if occupied_
+public:
+    Slot() = default;
+    Slot(int idx, VehicleType vt) : index_(idx), type_(vt), occupied_(false) {}
+
+    int index() const { return index_; }             // 0-based internal
+    VehicleType type() const { return type_; }
+    bool occupied() const { return occupied_; }
+    bool closed() const { return closed_; }
+    void setClosed(bool c) { closed_ = c; }
+    void setType(VehicleType vt) { type_ = vt; }
+
+    // assign a ticket and mark occupied
+    void assignTicket(shared_ptr<const Ticket> t) {
+        ticket_ = move(t);
+        occupied_ = true;
+    }
+    // drop the ticket and mark free
+    void vacate() {
+        occupied_ = false;
+        ticket_.reset();
+    }
+    const shared_ptr<const Ticket>& ticketRef() const { return ticket_; }
+    const Ticket& getTicket() const {
+        static const Ticket none = Ticket();
+        return ticket_ ? *ticket_ : none;
+    }
+};
+
+/* ------------------ WaitEntry ------------------
+   Simple struct used in the FIFO waitlist queue.
+*/
+struct WaitEntry {
+    string vehicleID;
+    VehicleType type;
+    long long since;   // lot clock (minutes) when the vehicle joined the queue
+    WaitEntry(string v = "", VehicleType t = VehicleType::CAR, long long at = 0) : vehicleID(v), type(t), since(at) {}
+};
+
+/* ------------------ Allocation strategies ------------------
+   Each vehicle type owns one SlotAllocator holding its free slot indices.
+   The strategy decides which free slot acquire() hands out:
+    - LOWEST_INDEX : smallest index first (free bitmap, the original behaviour)
+    - NEAREST_GATE : smallest distance to the entry gate (distance table)
+    - NEAREST_EXIT : smallest distance to the exit (distance table)
+    - ROUND_ROBIN  : next free index after the last one handed out, wrapping,
+                     so wear is spread over the whole block
+    - LEVEL_FILL   : fill the busiest level that still has room before
+                     opening emptier ones
+   All operations are O(log n). bulkLoad() fills an empty allocator in O(n).
+*/
+enum class AllocationStrategy { LOWEST_INDEX = 0, NEAREST_GATE = 1, NEAREST_EXIT = 2, ROUND_ROBIN = 3, LEVEL_FILL = 4 };
+static const int kAllocationStrategyCount = 5;
+
+static string strategyToStr(AllocationStrategy st) {
+    switch (st) {
+        case AllocationStrategy::LOWEST_INDEX: return "lowest-index";
+        case AllocationStrategy::NEAREST_GATE: return "nearest-gate";
+        case AllocationStrategy::NEAREST_EXIT: return "nearest-exit";
+        case AllocationStrategy::ROUND_ROBIN:  return "round-robin";
+        default:                               return "level-fill";
+    }
+}
+
+class SlotAllocator {
+public:
+    virtual ~SlotAllocator() = default;
+    virtual void release(int idx) = 0;   // slot becomes free
+    virtual int acquire() = 0;           // take a free slot, -1 if none
+    virtual void erase(int idx) = 0;     // take a specific free slot
+    virtual size_t size() const = 0;
+    virtual bool contains(int idx) const = 0;   // is idx free in this pool (audits)
+    // Copy sharing all paged storage with this allocator (lot forks)
+    virtual unique_ptr<SlotAllocator> clone() const = 0;
+    bool empty() const { return size() == 0; }
+    // Fill an empty allocator from ascending indices; overridden to build in O(n)
+    virtual void bulkLoad(const vector<int>& ascending) { for (int idx : ascending) release(idx); }
+};
+
+/* Heap-backed allocators support erase() by lazy deletion: membership is
+   tracked in a flag array and entries no longer free are skipped on pop.
+   Erased entries (and the duplicate a later release of the same slot
+   pushes) are dropped by rebuilding once the heap is more than twice the
+   free count, so its size stays O(free slots) at amortized O(1) per erase.
+   The binary heap lives in a PagedVector, so a forked allocator copies only
+   the pages along the sift paths it actually walks. */
+template <typename Key>
+class LazyHeapAllocator : public SlotAllocator {
+private:
+    using Item = pair<Key,int>;
+    PagedVector<Item> heap_;      // min-heap, standard array layout
+    PagedVector<char> in_;
+    size_t count_ = 0;
+
+    void siftUp(size_t i) {
+        Item x = heap_[i];
+        while (i > 0) {
+            size_t parent = (i - 1) / 2;
+            if (!(x < heap_[parent])) break;
+            heap_.mut(i) = heap_[parent];
+            i = parent;
+        }
+        heap_.mut(i) = x;
+    }
+    void popTop() {
+        Item x = heap_.back();
+        heap_.pop_back();
+        size_t n = heap_.size(), i = 0;
+        if (n == 0) return;
+        while (true) {
+            size_t c = 2 * i + 1;
+            if (c >= n) break;
+            if (c + 1 < n && heap_[c + 1] < heap_[c]) ++c;
+            if (!(heap_[c] < x)) break;
+            heap_.mut(i) = heap_[c];
+            i = c;
+        }
+        heap_.mut(i) = x;
+    }
+    // Rebuild from the live entries, one per free slot
+    void compact() {
+        vector<Item> items;
+        items.reserve(count_);
+        for (size_t i = 0; i < heap_.size(); ++i) {
+            int idx = heap_[i].second;
+            if (in_[idx] != 1) continue;   // erased, or a duplicate already taken
+            in_.mut(idx) = 2;
+            items.push_back(heap_[i]);
+        }
+        for (const auto &it : items) in_.mut(it.second) = 1;
+        make_heap(items.begin(), items.end(), greater<Item>());
+        heap_.clear();
+        heap_.reserve(items.size());
+        for (const auto &it : items) heap_.push_back(it);
+    }
+protected:
+    virtual Key keyFor(int idx) const = 0;
+public:
+    void release(int idx) override {
+        if (idx >= (int)in_.size()) in_.resize(idx + 1, 0);
+        if (in_[idx]) return;
+        in_.mut(idx) = 1;
+        ++count_;
+        heap_.push_back(Item(keyFor(idx), idx));
+        siftUp(heap_.size() - 1);
+    }
+    int acquire() override {
+        while (!heap_.empty()) {
+            int idx = heap_[0].second;
+            popTop();
+            if (in_[idx]) { in_.mut(idx) = 0; --count_; return idx; }
+        }
+        return -1;
+    }
+    void erase(int idx) override {
+        if (idx < (int)in_.size() && in_[idx]) { in_.mut(idx) = 0; --count_; }
+        if (heap_.size() > 2 * count_) compact();
+    }
+    void bulkLoad(const vector<int>& ascending) override {
+        if (ascending.empty()) return;
+        in_.assign(ascending.back() + 1, 0);
+        vector<Item> items;
+        items.reserve(ascending.size());
+        for (int idx : ascending) {
+            in_.mut(idx) = 1;
+            items.emplace_back(keyFor(idx), idx);
+        }
+        count_ = items.size();
+        make_heap(items.begin(), items.end(), greater<Item>());   // O(n), same layout as siftUp/popTop
+        heap_.clear();
+        heap_.reserve(items.size());
+        for (const auto &it : items) heap_.push_back(it);
+    }
+    size_t size() const override { return count_; }
+    bool contains(int idx) const override { return idx >= 0 && idx < (int)in_.size() && in_[idx]; }
+    // Heap length including entries not yet dropped by lazy deletion
+    size_t heapEntries() const { return heap_.size(); }
+};
+
+// Smallest index first
+/* Hierarchical bitmap of free indices: level 0 has one bit per slot and each
+   level above one bit per non-empty word below, so the lowest set bit at or
+   after any position takes O(log64 n) word steps. Built from a sorted list
+   in O(n / 64) beyond setting the bits. Levels are paged (copy-on-write). */
+class FreeBitmap {
+private:
+    vector<PagedVector<uint64_t>> lv_;   // lv_[0] = slots, lv_.back() has one word
+    size_t count_ = 0;
+    size_t capacity_ = 0;                // bits in level 0
+
+    // Size every level for 'bits' slots and recompute the summaries
+    void resize(size_t bits) {
+        capacity_ = bits;
+        if (lv_.empty()) lv_.emplace_back();
+        lv_.resize(1);
+        lv_[0].resize((bits + 63) / 64, 0);
+        while (lv_.back().size() > 1) {
+            const auto &below = lv_.back();
+            PagedVector<uint64_t> up;
+            up.assign((below.size() + 63) / 64, 0);
+            for (size_t w = 0; w < below.size(); ++w) if (below[w]) up.mut(w >> 6) |= 1ULL << (w & 63);
+            lv_.push_back(move(up));
+        }
+    }
+
+    // Lowest set bit >= pos within 'level', -1 if none. A miss in the
+    // current word asks the level above for the next non-empty word.
+    long long findAt(size_t level, size_t pos) const {
+        if (level >= lv_.size()) return -1;
+        const auto &words = lv_[level];
+        size_t w = pos >> 6;
+        if (w >= words.size()) return -1;
+        uint64_t bits = words[w] & (~0ULL << (pos & 63));
+        if (bits) return (long long)(w * 64 + __builtin_ctzll(bits));
+        long long up = findAt(level + 1, w + 1);
+        if (up < 0) return -1;
+        return (long long)((size_t)up * 64 + __builtin_ctzll(words[up]));
+    }
+
+public:
+    size_t count() const { return count_; }
+    bool test(size_t i) const { return i < capacity_ && (lv_[0][i >> 6] >> (i & 63) & 1); }
+
+    void set(size_t i) {
+        if (i >= capacity_) resize(max(i + 1, capacity_ * 2));
+        if (test(i)) return;
+        ++count_;
+        for (size_t l = 0; l < lv_.size(); ++l, i >>= 6) {
+            uint64_t &w = lv_[l].mut(i >> 6);
+            bool wasEmpty = w == 0;
+            w |= 1ULL << (i & 63);
+            if (!wasEmpty) break;
+        }
+    }
+
+    void clear(size_t i) {
+        if (!test(i)) return;
+        --count_;
+        for (size_t l = 0; l < lv_.size(); ++l, i >>= 6) {
+            uint64_t &w = lv_[l].mut(i >> 6);
+            w &= ~(1ULL << (i & 63));
+            if (w) break;
+        }
+    }
+
+    // Lowest set index >= pos, -1 if none
+    long long next(size_t pos) const { return findAt(0, pos); }
+
+    // Replace the contents with the given ascending indices
+    void assign(const vector<int>& ascending) {
+        lv_.clear();
+        count_ = ascending.size();
+        if (ascending.empty()) { capacity_ = 0; return; }
+        lv_.emplace_back();
+        lv_[0].assign((ascending.back() + 64) / 64, 0);
+        for (int idx : ascending) lv_[0].mut(idx >> 6) |= 1ULL << (idx & 63);
+        resize((size_t)ascending.back() + 1);
+    }
+};
+
+// Smallest index first
+class LowestIndexAllocator : public SlotAllocator {
+private:
+    FreeBitmap free_;
+public:
+    void release(int idx) override { free_.set(idx); }
+    int acquire() override {
+        long long idx = free_.next(0);
+        if (idx >= 0) free_.clear(idx);
+        return (int)idx;
+    }
+    void erase(int idx) override { free_.clear(idx); }
+    size_t size() const override { return free_.count(); }
+    bool contains(int idx) const override { return idx >= 0 && free_.test(idx); }
+    unique_ptr<SlotAllocator> clone() const override { return make_unique<LowestIndexAllocator>(*this); }
+    void bulkLoad(const vector<int>& ascending) override { free_.assign(ascending); }
+};
+
+// Smallest distance first; ties broken by index. dist is shared with the lot
+// and never changes; slots added after it was built are keyed past every
+// table entry in index order (farBeyond) or at 0.
+class DistanceAllocator : public LazyHeapAllocator<int> {
+private:
+    shared_ptr<const vector<int>> dist_;
+    bool farBeyond_;
+protected:
+    int keyFor(int idx) const override {
+        if (idx < (int)dist_->size()) return (*dist_)[idx];
+        return farBeyond_ ? (1 << 29) + idx : 0;
+    }
+public:
+    DistanceAllocator(shared_ptr<const vector<int>> dist, bool farBeyond) : dist_(move(dist)), farBeyond_(farBeyond) {}
+    unique_ptr<SlotAllocator> clone() const override { return make_unique<DistanceAllocator>(*this); }
+};
+
+// Next free index at or after the cursor, wrapping around
+class RoundRobinAllocator : public SlotAllocator {
+private:
+    FreeBitmap free_;
+    int cursor_ = 0;
+public:
+    void release(int idx) override { free_.set(idx); }
+    int acquire() override {
+        if (free_.count() == 0) return -1;
+        long long idx = free_.next(cursor_);
+        if (idx < 0) idx = free_.next(0);
+        free_.clear(idx);
+        cursor_ = (int)idx + 1;
+        return (int)idx;
+    }
+    void erase(int idx) override { free_.clear(idx); }
+    size_t size() const override { return free_.count(); }
+    bool contains(int idx) const override { return idx >= 0 && free_.test(idx); }
+    unique_ptr<SlotAllocator> clone() const override { return make_unique<RoundRobinAllocator>(*this); }
+    void bulkLoad(const vector<int>& ascending) override { free_.assign(ascending); }
+};
+
+// Levels are consecutive runs of slotsPerLevel indices. Picks the level with
+// the fewest free slots (but at least one), then its lowest free index.
+// Free slots sit in a FreeBitmap; a min segment tree over levels (keyed by
+// free count, empty levels = INT_MAX, ties to the lower level) finds the
+// level. Both are paged.
+class LevelFillAllocator : public SlotAllocator {
+private:
+    int slotsPerLevel_;
+    FreeBitmap free_;
+    PagedVector<int> freeIn_;     // free count per level
+    PagedVector<int> tree_;       // min key; leaves at [leaves_, 2 * leaves_)
+    size_t leaves_ = 0;
+
+    static int keyOf(int freeCount) { return freeCount > 0 ? freeCount : INT_MAX; }
+
+    void update(size_t level) {
+        size_t x = leaves_ + level;
+        tree_.mut(x) = keyOf(freeIn_[level]);
+        for (x >>= 1; x >= 1; x >>= 1) {
+            int m = min(tree_[2 * x], tree_[2 * x + 1]);
+            if (tree_[x] == m) break;
+            tree_.mut(x) = m;
+        }
+    }
+    // Room for 'levels' levels: doubles the leaves and rebuilds, amortized O(1)
+    void ensureLevels(size_t levels) {
+        if (levels > freeIn_.size()) freeIn_.resize(levels, 0);
+        if (levels <= leaves_) return;
+        size_t leaves = max<size_t>(1, leaves_);
+        while (leaves < levels) leaves <<= 1;
+        leaves_ = leaves;
+        tree_.assign(2 * leaves_, INT_MAX);
+        for (size_t l = 0; l < freeIn_.size(); ++l) tree_.mut(leaves_ + l) = keyOf(freeIn_[l]);
+        for (size_t x = leaves_ - 1; x >= 1; --x) tree_.mut(x) = min(tree_[2 * x], tree_[2 * x + 1]);
+    }
+    void adjust(int idx, int d) {
+        size_t level = (size_t)(idx / slotsPerLevel_);
+        ensureLevels(level + 1);
+        freeIn_.mut(level) += d;
+        update(level);
+    }
+public:
+    explicit LevelFillAllocator(int slotsPerLevel) : slotsPerLevel_(max(1, slotsPerLevel)) {}
+    void release(int idx) override {
+        if (free_.test(idx)) return;
+        free_.set(idx);
+        adjust(idx, 1);
+    }
+    int acquire() override {
+        if (leaves_ == 0 || tree_[1] == INT_MAX) return -1;
+        size_t x = 1;
+        while (x < leaves_) x = tree_[2 * x] <= tree_[2 * x + 1] ? 2 * x : 2 * x + 1;
+        int idx = (int)free_.next((x - leaves_) * slotsPerLevel_);
+        free_.clear(idx);
+        adjust(idx, -1);
+        return idx;
+    }
+    void erase(int idx) override {
+        if (!free_.test(idx)) return;
+        free_.clear(idx);
+        adjust(idx, -1);
+    }
+    size_t size() const override { return free_.count(); }
+    bool contains(int idx) const override { return idx >= 0 && free_.test(idx); }
+    unique_ptr<SlotAllocator> clone() const override { return make_unique<LevelFillAllocator>(*this); }
+    void bulkLoad(const vector<int>& ascending) override {
+        if (ascending.empty()) return;
+        free_.assign(ascending);
+        size_t levels = (size_t)(ascending.back() / slotsPerLevel_) + 1;
+        freeIn_.assign(levels, 0);
+        for (int idx : ascending) freeIn_.mut(idx / slotsPerLevel_) += 1;
+        leaves_ = 0;
+        ensureLevels(levels);
+    }
+};
+
+/* ------------------ FreeRunIndex ------------------
+   Segment tree over a contiguous index range [lo, lo + n) recording which
+   slots are free. Each node keeps the longest free run inside it plus the
+   free prefix/suffix lengths, so the lowest run of k adjacent free slots is
+   found by one root-to-leaf descent. set() and findRun() are O(log n).
+   cover() grows the range for slots added at runtime; leaves are kept at
+   twice the range so growing upward is amortized O(log n).
+*/
+class FreeRunIndex {
+private:
+    struct Node { int pref = 0, suf = 0, best = 0, len = 0; };
+    int lo_ = 0, n_ = 0, size_ = 0;   // size_ = leaf count (power of two)
+    PagedVector<Node> t_;
+
+    static Node combine(const Node& a, const Node& b) {
+        Node r;
+        r.len = a.len + b.len;
+        r.pref = a.pref == a.len ? a.len + b.pref : a.pref;
+        r.suf = b.suf == b.len ? b.len + a.suf : b.suf;
+        r.best = max(max(a.best, b.best), a.suf + b.pref);
+        return r;
+    }
+
+public:
+    bool active() const { return n_ > 0; }
+    int lo() const { return lo_; }
+    int hi() const { return lo_ + n_; }
+
+    // Build over [lo, lo + n) with every position marked used
+    void build(int lo, int n, int capacity = 0) {
+        lo_ = lo; n_ = n;
+        size_ = 1;
+        while (size_ < max(max(n, capacity), 1)) size_ <<= 1;
+        t_.assign(2 * size_, Node{});
+        for (int i = 0; i < n; ++i) t_.mut(size_ + i).len = 1;
+        for (int i = size_ - 1; i >= 1; --i) t_.mut(i) = combine(t_[2 * i], t_[2 * i + 1]);
+    }
+    void clear() { lo_ = n_ = size_ = 0; t_.clear(); }
+
+    // Build over [lo, lo + n) with the given ascending indices free, O(n)
+    void build(int lo, int n, const vector<int>& freeAscending) {
+        build(lo, n);
+        for (int idx : freeAscending) {
+            Node &leaf = t_.mut(size_ + idx - lo_);
+            leaf.pref = leaf.suf = leaf.best = 1;
+        }
+        for (int i = size_ - 1; i >= 1; --i) t_.mut(i) = combine(t_[2 * i], t_[2 * i + 1]);
+    }
+
+    // Extend the range to include idx (as used); existing free state is kept
+    void cover(int idx) {
+        if (!n_) { build(idx, 1); return; }
+        if (idx >= lo_ && idx < lo_ + n_) return;
+        int newLo = min(lo_, idx), newHi = max(lo_ + n_, idx + 1);
+        if (newLo == lo_ && newHi - lo_ <= size_) {
+            for (int i = n_; i < newHi - lo_; ++i) {
+                int p = size_ + i;
+                t_.mut(p).len = 1;
+                for (p >>= 1; p >= 1; p >>= 1) t_.mut(p) = combine(t_[2 * p], t_[2 * p + 1]);
+            }
+            n_ = newHi - lo_;
+            return;
+        }
+        vector<int> freeAt;
+        for (int i = 0; i < n_; ++i) if (t_[size_ + i].best) freeAt.push_back(lo_ + i);
+        build(newLo, newHi - newLo, 2 * (newHi - newLo));
+        for (int i : freeAt) set(i, true);
+    }
+
+    void set(int idx, bool free) {
+        int i = idx - lo_;
+        if (i < 0 || i >= n_) return;
+        int p = size_ + i;
+        Node &leaf = t_.mut(p);
+        leaf.pref = leaf.suf = leaf.best = free ? 1 : 0;
+        for (p >>= 1; p >= 1; p >>= 1) t_.mut(p) = combine(t_[2 * p], t_[2 * p + 1]);
+    }
+
+    int longestRun() const { return n_ ? t_[1].best : 0; }
+    bool isFree(int idx) const { return idx >= lo_ && idx < lo_ + n_ && t_[size_ + idx - lo_].best; }
+
+    // Lowest start index of k adjacent free slots, -1 if none
+    int findRun(int k) const {
+        if (!n_ || t_[1].best < k) return -1;
+        int p = 1, offset = 0, width = size_;
+        while (p < size_) {
+            const Node &l = t_[2 * p], &r = t_[2 * p + 1];
+            width >>= 1;
+            if (l.best >= k) { p = 2 * p; }
+            else if (l.suf + r.pref >= k) return lo_ + offset + width - l.suf;
+            else { p = 2 * p + 1; offset += width; }
+        }
+        return lo_ + offset;
+    }
+};
+
+/* ------------------ GarageTopology ------------------
+   Physical layout of a site: site -> level -> zone -> slot, loaded from a
+   layout file. Each zone holds one slot class and its slots get consecutive
+   indices, first slot nearest the zone entrance. Immutable once loaded, so
+   lots share it by shared_ptr; free-capacity counts live in the lot.
+   levels_  : level names, in ramp order (adjacent levels share a ramp)
+   zones_   : level, slot class, first slot index, slot count, position
+   gates_   : level and position of each entry gate
+   routes_  : per gate, levels nearest-first, each with its zones
+              nearest-first; the lot walks this to find the nearest free slot
+
+   Distance from a gate to a slot (used for routes and distance tables):
+     |level difference| * rampCost + |position difference| + offset in zone
+
+   Layout file ('#' starts a comment):
+     site  NAME
+     ramp  COST                      (default 100)
+     level NAME
+     zone  NAME CLASS SLOTS POSITION (in the most recent level)
+     gate  NAME LEVEL POSITION
+*/
+class GarageTopology {
+public:
+    struct Zone {
+        string name;
+        int level;
+        VehicleType type;
+        int first;
+        int count;
+        int position;
+    };
+    struct Gate {
+        string name;
+        int level;
+        int position;
+    };
+    struct LevelRoute {
+        int level;
+        vector<int> zones;   // nearest first
+    };
+
+private:
+    string site_ = "Site";
+    int rampCost_ = 100;
+    vector<string> levels_;
+    vector<Zone> zones_;
+    vector<Gate> gates_;
+    vector<int> zoneOfSlot_;
+    vector<vector<LevelRoute>> routes_;
+
+    int zoneDistance(const Gate &g, const Zone &z) const {
+        return abs(g.level - z.level) * rampCost_ + abs(g.position - z.position);
+    }
+
+    void buildRoutes() {
+        routes_.assign(gates_.size(), {});
+        for (size_t g = 0; g < gates_.size(); ++g) {
+            vector<LevelRoute> route(levels_.size());
+            for (size_t l = 0; l < levels_.size(); ++l) route[l].level = (int)l;
+            for (size_t z = 0; z < zones_.size(); ++z) route[zones_[z].level].zones.push_back((int)z);
+            auto levelCost = [&](const LevelRoute &r) {
+                int best = INT32_MAX;
+                for (int z : r.zones) best = min(best, zoneDistance(gates_[g], zones_[z]));
+                return best;
+            };
+            for (auto &r : route) {
+                stable_sort(r.zones.begin(), r.zones.end(), [&](int a, int b) {
+                    return zoneDistance(gates_[g], zones_[a]) < zoneDistance(gates_[g], zones_[b]);
+                });
+            }
+            stable_sort(route.begin(), route.end(), [&](const LevelRoute &a, const LevelRoute &b) {
+                return levelCost(a) < levelCost(b);
+            });
+            routes_[g] = move(route);
+        }
+    }
+
+public:
+    // Parse a layout file; on error returns false with "path:line: message"
+    bool loadFile(const string &path, string &err) {
+        ifstream in(path);
+        if (!in) { err = "cannot open " + path; return false; }
+        GarageTopology t;
+        string line;
+        int lineNo = 0;
+        auto fail = [&](const string &msg) { err = path + ":" + to_string(lineNo) + ": " + msg; return false; };
+        while (getline(in, line)) {
+            ++lineNo;
+            size_t hashPos = line.find('#');
+            if (hashPos != string::npos) line.resize(hashPos);
+            istringstream ls(line);
+            string kw;
+            if (!(ls >> kw)) continue;
+            if (kw == "site") {
+                if (!(ls >> t.site_)) return fail("expected: site NAME");
+            } else if (kw == "ramp") {
+                if (!(ls >> t.rampCost_) || t.rampCost_ < 0) return fail("expected: ramp COST (>= 0)");
+            } else if (kw == "level") {
+                string name;
+                if (!(ls >> name)) return fail("expected: level NAME");
+                t.levels_.push_back(name);
+            } else if (kw == "zone") {
+                Zone z;
+                string cls;
+                if (!(ls >> z.name >> cls >> z.count >> z.position)) return fail("expected: zone NAME CLASS SLOTS POSITION");
+                if (t.levels_.empty()) return fail("zone before any level");
+                int ord = VehicleClassRegistry::instance().find(cls);
+                if (ord < 0) return fail("unknown vehicle class '" + cls + "'");
+                if (!ownsSlots((VehicleType)ord)) return fail("'" + cls + "' parks in another class's slots");
+                if (z.count <= 0) return fail("zone needs at least one slot");
+                z.level = (int)t.levels_.size() - 1;
+                z.type = (VehicleType)ord;
+                z.first = (int)t.zoneOfSlot_.size();
+                t.zoneOfSlot_.insert(t.zoneOfSlot_.end(), z.count, (int)t.zones_.size());
+                t.zones_.push_back(z);
+            } else if (kw == "gate") {
+                Gate g;
+                string level;
+                if (!(ls >> g.name >> level >> g.position)) return fail("expected: gate NAME LEVEL POSITION");
+                auto it = find(t.levels_.begin(), t.levels_.end(), level);
+                if (it == t.levels_.end()) return fail("unknown level '" + level + "'");
+                g.level = (int)(it - t.levels_.begin());
+                t.gates_.push_back(g);
+            } else {
+                return fail("unknown directive '" + kw + "'");
+            }
+        }
+        if (t.zones_.empty()) { err = path + ": layout has no zones"; return false; }
+        if (t.gates_.empty()) t.gates_.push_back(Gate{"Main", 0, 0});
+        t.buildRoutes();
+        *this = move(t);
+        return true;
+    }
+
+    const string& site() const { return site_; }
+    int slotCount() const { return (int)zoneOfSlot_.size(); }
+    int levelCount() const { return (int)levels_.size(); }
+    const string& levelName(int l) const { return levels_[l]; }
+    const vector<Zone>& zones() const { return zones_; }
+    const vector<Gate>& gates() const { return gates_; }
+    int zoneOf(int idx) const { return zoneOfSlot_[idx]; }
+    int levelOf(int idx) const { return zones_[zoneOfSlot_[idx]].level; }
+    const vector<LevelRoute>& route(int gate) const { return routes_[gate]; }
+
+    // Per-slot distance from one gate (for the NEAREST_GATE / NEAREST_EXIT tables)
+    vector<int> distancesFrom(int gate) const {
+        vector<int> d(zoneOfSlot_.size());
+        for (const auto &z : zones_)
+            for (int k = 0; k < z.count; ++k) d[z.first + k] = zoneDistance(gates_[gate], z) + k;
+        return d;
+    }
+};
+
+/* ------------------ CapacityTimeline ------------------
+   Booked-count per time bucket for one slot type, as a segment tree with
+   lazy range-add and range-max. "Is there capacity for [t1,t2)" is one
+   range-max query, and booking/cancelling is one range-add: both O(log n)
+   in the number of buckets, independent of how many bookings exist.
+   Times are minutes; the horizon starts at origin and spans kBuckets buckets.
+*/
+class CapacityTimeline {
+public:
+    static const int kBucketMinutes = 15;
+    static const int kBuckets = 1 << 13;          // ~85 days at 15 minutes
+
+private:
+    long long origin_ = 0;
+    PagedVector<int> mx_, lazy_;     // paged: forks share untouched buckets
+
+    void add(int node, int l, int r, int ql, int qr, int v) {
+        if (qr <= l || r <= ql) return;
+        if (ql <= l && r <= qr) { mx_.mut(node) += v; lazy_.mut(node) += v; return; }
+        int m = (l + r) / 2;
+        add(2 * node, l, m, ql, qr, v);
+        add(2 * node + 1, m, r, ql, qr, v);
+        mx_.mut(node) = lazy_[node] + max(mx_[2 * node], mx_[2 * node + 1]);
+    }
+    int query(int node, int l, int r, int ql, int qr) const {
+        if (qr <= l || r <= ql) return 0;
+        if (ql <= l && r <= qr) return mx_[node];
+        int m = (l + r) / 2;
+        return lazy_[node] + max(query(2 * node, l, m, ql, qr), query(2 * node + 1, m, r, ql, qr));
+    }
+
+public:
+    CapacityTimeline() { reset(0); }
+
+    void reset(long long origin) {
+        origin_ = origin - origin % kBucketMinutes;
+        mx_.assign(2 * kBuckets, 0);
+        lazy_.assign(2 * kBuckets, 0);
+    }
+    long long origin() const { return origin_; }
+    long long horizonEnd() const { return origin_ + (long long)kBuckets * kBucketMinutes; }
+
+    // Bucket range [b1,b2) covering [t1,t2); false if outside the horizon
+    bool bucketRange(long long t1, long long t2, int& b1, int& b2) const {
+        if (t2 <= t1 || t1 < origin_ || t2 > horizonEnd()) return false;
+        b1 = (int)((t1 - origin_) / kBucketMinutes);
+        b2 = (int)((t2 - origin_ + kBucketMinutes - 1) / kBucketMinutes);
+        return true;
+    }
+    int maxBooked(long long t1, long long t2) const {
+        int b1, b2;
+        return bucketRange(t1, t2, b1, b2) ? query(1, 0, kBuckets, b1, b2) : 0;
+    }
+    void book(long long t1, long long t2, int delta) {
+        int b1, b2;
+        if (bucketRange(t1, t2, b1, b2)) add(1, 0, kBuckets, b1, b2, delta);
+    }
+};
+
+/* ------------------ Reservation ------------------
+   A pre-booked slot for one vehicle type over [start, end) (minutes).
+   BOOKED  : capacity counted, no slot yet
+   HELD    : start reached, a slot is taken out of the free pool for it
+   CLAIMED : the customer arrived and the hold became a normal ticket
+   Finished reservations (end reached, or cancelled) are dropped.
+*/
+struct Reservation {
+    enum State { BOOKED, HELD, CLAIMED };
+    long long id = 0;
+    string customer;
+    VehicleType vtype = VehicleType::CAR;
+    VehicleType slotType = VehicleType::CAR;   // slotTypeFor(vtype): timeline, pending queue and pool it uses
+    long long start = 0, end = 0;
+    int slotIndex = -1;           // valid while HELD
+    State state = BOOKED;
+};
+
+static string reservationStateToStr(Reservation::State st) {
+    switch (st) {
+        case Reservation::BOOKED:  return "BOOKED";
+        case Reservation::HELD:    return "HELD";
+        default:                   return "CLAIMED";
+    }
+}
+
+/* ------------------ OccupancyForecaster ------------------
+   Online time series of entries/exits per slot type in 5-minute buckets.
+    - ring of the last week of raw per-bucket counts (paged, copy-on-write)
+    - EWMA of net flow (entries - exits) per bucket
+    - seasonal average of net flow per (day-of-week, 5-minute slot)
+   record() is O(1); closing a bucket folds it into both averages. Buckets
+   that pass with no events are folded in closed form: the EWMA decays by
+   (1 - alpha)^gap at once and a weekly slot applies the empty closes it
+   missed when it is next closed or read, so a gap shorter than a week
+   costs O(classes). Longer gaps count as one week of empty buckets, folded
+   by a single pass over the weekly slots. forecast() is const: it walks
+   the next buckets blending the seasonal profile with the recent trend.
+*/
+class OccupancyForecaster {
+public:
+    static const int kBucketMinutes = 5;
+    static const int kWeekBuckets = 7 * 24 * 60 / kBucketMinutes;   // 2016
+
+private:
+    struct Counts { uint32_t entries[kMaxVehicleClasses]; uint32_t exits[kMaxVehicleClasses]; };
+    // Everything kept for one 5-minute slot of the week
+    struct WeekSlot {
+        Counts ring;                           // raw counts of the bucket held
+        long long ringBucket = -1;             // bucket the ring cell holds, -1 none
+        float seasonal[kMaxVehicleClasses];
+        uint16_t seen = 0;                     // closed buckets folded into the average
+        long long closedAt = -1;               // last bucket explicitly folded in, -1 none
+    };
+    // Indexed by bucket % kWeekBuckets; paged (~3 KB per 8 slots) so a
+    // snapshot fork shares it and the live lot's next record() clones the
+    // pages it touches, not the ~800 KB week
+    PagedVector<WeekSlot, 3> week_;
+    double ewma_[kMaxVehicleClasses] = {0};
+    long long origin_ = -1;                    // first bucket; none before it is ever closed
+    long long current_ = -1;                   // bucket id being filled
+    double alpha_ = 0.2;                       // EWMA weight of the newest bucket
+    double beta_ = 0.25;                       // seasonal weight of the newest week
+
+    static int weekSlot(long long bucket) { return (int)(((bucket % kWeekBuckets) + kWeekBuckets) % kWeekBuckets); }
+    static long long floorDiv(long long a, long long b) { return a >= 0 ? a / b : -((-a + b - 1) / b); }
+
+    // Buckets b with after < b < before that fall in weekly slot ws
+    static long long slotHits(int ws, long long after, long long before) {
+        if (before - 1 <= after) return 0;
+        return floorDiv(before - 1 - ws, kWeekBuckets) - floorDiv(after - ws, kWeekBuckets);
+    }
+    // Factor left after folding n zero-net buckets into an average of weight w
+    static double decay(double w, long long n) { return n <= 0 ? 1.0 : pow(1 - w, (double)n); }
+
+    // Empty buckets of weekly slot ws closed after 'from' and before 'before'
+    long long idleCloses(int ws, long long from, long long before) const {
+        return slotHits(ws, max(from, origin_ - 1), before);
+    }
+
+    // Weekly slot ws of class t once every bucket before 'now' is closed;
+    // seen = buckets folded into it
+    double seasonalAsOf(int ws, int t, long long now, long long& seen) const {
+        const WeekSlot &w = week_[ws];
+        double s = w.seasonal[t];
+        long long from = w.closedAt;
+        seen = w.seen;
+        if (now > current_ && weekSlot(current_) == ws) {   // the open bucket closes first
+            long long idle = idleCloses(ws, from, current_);
+            s *= decay(beta_, idle);
+            seen += idle;
+            double net = (double)w.ring.entries[t] - (double)w.ring.exits[t];
+            s = seen == 0 ? net : beta_ * net + (1 - beta_) * s;
+            ++seen;
+            from = current_;
+        }
+        // advance() clamps a gap longer than a week to one empty bucket per slot
+        long long idle = now - current_ - 1 > kWeekBuckets ? idleCloses(ws, from, current_ + 1) + 1
+                                                           : idleCloses(ws, from, now);
+        seen += idle;
+        return s * decay(beta_, idle);
+    }
+
+    void openBucket(long long bucket) {
+        WeekSlot &w = week_.mut(weekSlot(bucket));
+        w.ring = Counts{};
+        w.ringBucket = bucket;
+    }
+
+    void closeBucket(long long bucket) {
+        int ws = weekSlot(bucket);
+        WeekSlot &w = week_.mut(ws);
+        long long idle = idleCloses(ws, w.closedAt, bucket);
+        double keep = decay(beta_, idle);
+        long long seen = w.seen + idle;
+        for (int t = 0; t < vehicleClassCount(); ++t) {
+            double net = (double)w.ring.entries[t] - (double)w.ring.exits[t];
+            ewma_[t] = alpha_ * net + (1 - alpha_) * ewma_[t];
+            double prev = w.seasonal[t] * keep;
+            w.seasonal[t] = seen == 0 ? (float)net : (float)(beta_ * net + (1 - beta_) * prev);
+        }
+        w.seen = (uint16_t)min(0xFFFFLL, seen + 1);
+        w.closedAt = bucket;
+    }
+
+    // Move the current bucket forward to 'bucket', closing the ones passed
+    void advance(long long bucket) {
+        if (current_ < 0) { origin_ = current_ = bucket; openBucket(bucket); return; }
+        if (bucket <= current_) return;
+        closeBucket(current_);
+        long long gap = bucket - current_ - 1;                // idle buckets in between
+        double keep = decay(alpha_, min(gap, (long long)kWeekBuckets));
+        for (int t = 0; t < vehicleClassCount(); ++t) ewma_[t] *= keep;
+        if (gap > kWeekBuckets) {
+            // One cycle of empty buckets: each weekly slot folds what it has
+            // pending plus one empty close, ending at its bucket in the last week
+            long long weekStart = bucket - kWeekBuckets;
+            for (int ws = 0; ws < kWeekBuckets; ++ws) {
+                WeekSlot &w = week_.mut(ws);
+                long long n = idleCloses(ws, w.closedAt, current_ + 1) + 1;
+                double f = decay(beta_, n);
+                for (int t = 0; t < vehicleClassCount(); ++t) w.seasonal[t] = (float)(w.seasonal[t] * f);
+                w.seen = (uint16_t)min(0xFFFFLL, w.seen + n);
+                w.closedAt = weekStart + weekSlot((long long)ws - weekStart);
+            }
+        }
+        current_ = bucket;
+        openBucket(bucket);
+    }
+
+public:
+    OccupancyForecaster() { week_.resize(kWeekBuckets, WeekSlot{}); }   // one shared page until written
+
+    void reset() { *this = OccupancyForecaster(); }
+
+    // count > 0: slots taken, count < 0: slots freed
+    void record(long long nowMinutes, VehicleType slotType, int count) {
+        advance(nowMinutes / kBucketMinutes);
+        Counts &c = week_.mut(weekSlot(current_)).ring;
+        if (count > 0) c.entries[(int)slotType] += (uint32_t)count;
+        else c.exits[(int)slotType] += (uint32_t)(-count);
+    }
+
+    // Raw counts for a bucket still inside the ring (entries, exits)
+    pair<uint32_t,uint32_t> bucketCounts(long long bucket, VehicleType slotType) const {
+        const WeekSlot &w = week_[weekSlot(bucket)];
+        if (current_ < 0 || bucket > current_ || w.ringBucket != bucket) return {0, 0};
+        const Counts &c = w.ring;
+        return {c.entries[(int)slotType], c.exits[(int)slotType]};
+    }
+
+    // Projected occupancy of slotType at the end of each of the next 'hours'
+    // hours, starting from 'occupied' and clamped to [0, capacity].
+    vector<int> forecast(long long nowMinutes, VehicleType slotType, int occupied, int capacity, int hours) const {
+        long long now = max(current_, nowMinutes / kBucketMinutes);
+        vector<int> out;
+        double occ = occupied;
+        int t = (int)slotType;
+        double ewma = ewma_[t];
+        if (current_ >= 0 && now > current_) {   // as advance(now) would leave it
+            const Counts &c = week_[weekSlot(current_)].ring;
+            ewma = alpha_ * ((double)c.entries[t] - (double)c.exits[t]) + (1 - alpha_) * ewma;
+            ewma *= decay(alpha_, min(now - current_ - 1, (long long)kWeekBuckets));
+        }
+        const int perHour = 60 / kBucketMinutes;
+        for (int k = 1; k <= hours * perHour; ++k) {
+            int ws = weekSlot(now + k);
+            long long seen = 0;
+            double seasonal = current_ < 0 ? 0.0 : seasonalAsOf(ws, t, now, seen);
+            double net = seen ? 0.7 * seasonal + 0.3 * ewma : ewma;
+            occ = min((double)capacity, max(0.0, occ + net));
+            if (k % perHour == 0) out.push_back((int)(occ + 0.5));
+        }
+        return out;
+    }
+};
+
+/* ------------------ LogHistogram ------------------
+   HDR-style histogram of non-negative integers: exact below 32, then 32
+   linear sub-buckets per power of two (relative error under ~3%).
+   record() is O(1) (one count-leading-zeros), the footprint is fixed, and
+   two histograms merge by adding counts, so per-lot sketches can be summed
+   for regional reports. Counts are paged (copy-on-write, 2 KB pages) and
+   allocated on the first record(), so a snapshot fork shares them and the
+   next record() on the live lot clones one page, not the whole histogram.
+*/
+class LogHistogram {
+public:
+    static const int kSubBits = 5;
+    static const int kSub = 1 << kSubBits;
+    static const int kBuckets = (64 - kSubBits + 1) * kSub;
+
+private:
+    PagedVector<uint64_t, 8> counts_;   // empty until the first value
+    uint64_t total_ = 0;
+    uint64_t min_ = UINT64_MAX;
+    uint64_t max_ = 0;
+
+    static int bucketOf(uint64_t v) {
+        if (v < (uint64_t)kSub) return (int)v;
+        int e = 63 - __builtin_clzll(v);                 // e >= kSubBits
+        int sub = (int)((v >> (e - kSubBits)) & (kSub - 1));
+        return (e - kSubBits + 1) * kSub + sub;
+    }
+    // Midpoint of the values mapped to bucket b
+    static double valueOf(int b) {
+        if (b < kSub) return b;
+        int e = b / kSub + kSubBits - 1;
+        int sub = b % kSub;
+        double lo = (double)((uint64_t)(kSub + sub) << (e - kSubBits));
+        return lo + (double)(1ULL << (e - kSubBits)) / 2.0;
+    }
+
+public:
+    void record(uint64_t v) {
+        if (counts_.empty()) counts_.resize(kBuckets, 0);
+        ++counts_.mut(bucketOf(v));
+        ++total_;
+        if (v < min_) min_ = v;
+        if (v > max_) max_ = v;
+    }
+    void merge(const LogHistogram& o) {
+        if (o.total_ == 0) return;
+        if (counts_.empty()) counts_.resize(kBuckets, 0);
+        for (int b = 0; b < kBuckets; ++b)
+            if (o.counts_[b]) counts_.mut(b) += o.counts_[b];
+        total_ += o.total_;
+        min_ = min(min_, o.min_);
+        max_ = max(max_, o.max_);
+    }
+    uint64_t count() const { return total_; }
+
+    // Approximate q-quantile (0..1, nearest rank); 0 when empty
+    double quantile(double q) const {
+        if (total_ == 0) return 0.0;
+        uint64_t rank = max<uint64_t>(1, (uint64_t)ceil(q * (double)total_)), seen = 0;
+        for (int b = 0; b < kBuckets; ++b) {
+            seen += counts_[b];
+            if (seen >= rank) return min(max(valueOf(b), (double)min_), (double)max_);
+        }
+        return (double)max_;
+    }
+};
+
+/* ------------------ LotStatistics ------------------
+   Distribution statistics updated in O(1) per event:
+    - dwell[t]   : minutes parked per vehicle type (from the exit duration)
+    - fee[t]     : fee per vehicle type, in paise
+    - waitTime   : minutes spent on the waitlist before promotion
+    - peakOccupied, exits, trackedSince for turnover
+   merge() combines lots for regional reporting. Peaks of different lots
+   need not coincide, so a merged peakOccupied is the sum of per-lot peaks
+   (an upper bound on the regional peak) and is labelled as such.
+*/
+struct LotStatistics {
+    LogHistogram dwell[kMaxVehicleClasses];
+    LogHistogram fee[kMaxVehicleClasses];
+    LogHistogram waitTime;
+    long long peakOccupied = 0;
+    long long totalSlots = 0;
+    long long exits = 0;
+    long long trackedSince = 0;       // lot clock (minutes) when tracking began
+    long long trackedUntil = 0;       // latest event seen
+    int lots = 1;                     // lots merged into these figures
+
+    void merge(const LotStatistics& o) {
+        for (int t = 0; t < vehicleClassCount(); ++t) { dwell[t].merge(o.dwell[t]); fee[t].merge(o.fee[t]); }
+        waitTime.merge(o.waitTime);
+        peakOccupied += o.peakOccupied;      // sum of per-lot peaks (upper bound for the region)
+        lots += o.lots;
+        totalSlots += o.totalSlots;
+        exits += o.exits;
+        trackedSince = min(trackedSince, o.trackedSince);
+        trackedUntil = max(trackedUntil, o.trackedUntil);
+    }
+
+    // Exits per slot per day over the tracked period
+    double turnoverPerDay() const {
+        double days = max(60.0, (double)(trackedUntil - trackedSince)) / (24.0 * 60.0);
+        return totalSlots == 0 ? 0.0 : exits / (double)totalSlots / days;
+    }
+
+    void display(ostream& out = cout) const {
+        out << fixed << setprecision(2);
+        if (lots == 1) out << "Peak occupied slots   : " << peakOccupied << "\n";
+        else out << "Sum of per-lot peaks  : " << peakOccupied << " (upper bound on the regional peak)\n";
+        out << "Turnover (exits/slot/day): " << turnoverPerDay() << "\n";
+        out << "Dwell minutes / fee Rs (p50 / p90 / p99):\n";
+        for (int t = 0; t < vehicleClassCount(); ++t) {
+            if (dwell[t].count() == 0) continue;
+            out << "  " << left << setw(12) << vehicleTypeToStr((VehicleType)t) << right
+                 << " n=" << dwell[t].count()
+                 << " | dwell " << setprecision(0) << dwell[t].quantile(0.5) << " / " << dwell[t].quantile(0.9)
+                 << " / " << dwell[t].quantile(0.99) << setprecision(2)
+                 << " | fee " << fee[t].quantile(0.5) / 100 << " / " << fee[t].quantile(0.9) / 100
+                 << " / " << fee[t].quantile(0.99) / 100 << "\n";
+        }
+        if (waitTime.count()) {
+            out << "Waitlist wait minutes : n=" << waitTime.count() << setprecision(0)
+                 << " | p50 " << waitTime.quantile(0.5) << " | p90 " << waitTime.quantile(0.9)
+                 << " | p99 " << waitTime.quantile(0.99) << setprecision(2) << "\n";
+        }
+    }
+};
+
+/* ------------------ Instrumentation ------------------
+   Per-lot operation latency histograms (nanoseconds), hot-path counters
+   and an optional ring of timestamped spans that can be written out as
+   Chrome trace JSON (chrome://tracing, Perfetto).
+   Build with -DPARKING_INSTRUMENTATION=0 to compile every hook out; when
+   compiled in, a disabled lot pays one predictable branch per hook.
+*/
+#ifndef PARKING_INSTRUMENTATION
+#define PARKING_INSTRUMENTATION 1
+#endif
+
+enum class LotOp : uint8_t { Entry = 0, Exit = 1, Reserve = 2, Claim = 3, Cancel = 4 };
+static const int kLotOpCount = 5;
+
+static const char* lotOpName(LotOp op) {
+    static const char* names[kLotOpCount] = {"vehicleEntry", "vehicleExit", "reserve", "claimReservation", "cancelReservation"};
+    return names[(int)op];
+}
+
+enum class LotCounter : uint8_t { PoolOps = 0, MapProbes = 1, WaitlistPromotions = 2 };
+static const int kLotCounterCount = 3;
+
+static const char* lotCounterName(LotCounter c) {
+    static const char* names[kLotCounterCount] = {"pool_ops", "map_probes", "waitlist_promotions"};
+    return names[(int)c];
+}
+
+// Fixed latency bucket bounds (ns) exported as a Prometheus histogram
+static const int kPromLatencyBuckets = 10;
+static const int64_t kPromLatencyBoundsNs[kPromLatencyBuckets] = {
+    500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000
+};
+
+class Instrumentation {
+public:
+    struct Span { LotOp op; int64_t startNs; int64_t durNs; };
+
+    // Cumulative-free per-bucket counts readable from other threads
+    struct SharedLatency {
+        atomic<uint64_t> buckets[kPromLatencyBuckets + 1];   // last = +Inf
+        atomic<uint64_t> sumNs{0};
+        atomic<uint64_t> count{0};
+        SharedLatency() { for (auto &b : buckets) b.store(0, memory_order_relaxed); }
+    };
+
+private:
+    bool enabled_ = false;
+    bool tracing_ = false;
+    LogHistogram latency_[kLotOpCount];
+    uint64_t counters_[kLotCounterCount] = {0};
+    SharedLatency shared_[kLotOpCount];
+    vector<Span> trace_;          // ring, allocated when tracing starts
+    size_t traceNext_ = 0;
+    uint64_t traceTotal_ = 0;
+
+public:
+    static int64_t nowNs() {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    bool enabled() const { return enabled_; }
+    void setEnabled(bool on) { enabled_ = on; }
+
+    // Keep the last 'capacity' spans; 0 stops tracing and frees the buffer
+    void setTracing(size_t capacity) {
+        tracing_ = capacity > 0;
+        trace_.assign(capacity, Span{});
+        trace_.shrink_to_fit();
+        traceNext_ = 0;
+        traceTotal_ = 0;
+    }
+
+    void count(LotCounter c, uint64_t n = 1) { if (enabled_) counters_[(int)c] += n; }
+    uint64_t counter(LotCounter c) const { return counters_[(int)c]; }
+    const LogHistogram& latency(LotOp op) const { return latency_[(int)op]; }
+
+    const SharedLatency& shared(LotOp op) const { return shared_[(int)op]; }
+
+    void recordOp(LotOp op, int64_t startNs, int64_t endNs) {
+        int64_t d = max<int64_t>(0, endNs - startNs);
+        latency_[(int)op].record((uint64_t)d);
+        // Single writer: relaxed load+store is enough for readers on other threads
+        SharedLatency &sh = shared_[(int)op];
+        int b = 0;
+        while (b < kPromLatencyBuckets && d > kPromLatencyBoundsNs[b]) ++b;
+        sh.buckets[b].store(sh.buckets[b].load(memory_order_relaxed) + 1, memory_order_relaxed);
+        sh.sumNs.store(sh.sumNs.load(memory_order_relaxed) + (uint64_t)d, memory_order_relaxed);
+        sh.count.store(sh.count.load(memory_order_relaxed) + 1, memory_order_release);
+        if (tracing_) {
+            trace_[traceNext_] = Span{op, startNs, endNs - startNs};
+            traceNext_ = (traceNext_ + 1) % trace_.size();
+            ++traceTotal_;
+        }
+    }
+
+    void reset() {
+        for (auto &h : latency_) h = LogHistogram();
+        for (auto &c : counters_) c = 0;
+        traceNext_ = 0;
+        traceTotal_ = 0;
+    }
+
+    void display() const {
+        cout << "\n⏱️ Instrumentation (" << (enabled_ ? "on" : "off") << ")\n";
+        cout << "  Latency ns (n | p50 / p90 / p99):\n";
+        cout << fixed << setprecision(0);
+        for (int i = 0; i < kLotOpCount; ++i) {
+            const LogHistogram &h = latency_[i];
+            if (!h.count()) continue;
+            cout << "    " << left << setw(18) << lotOpName((LotOp)i) << right << " " << h.count() << " | "
+                 << h.quantile(0.5) << " / " << h.quantile(0.9) << " / " << h.quantile(0.99) << "\n";
+        }
+        for (int i = 0; i < kLotCounterCount; ++i)
+            cout << "  " << left << setw(20) << lotCounterName((LotCounter)i) << right << ": " << counters_[i] << "\n";
+        if (tracing_) cout << "  Trace spans buffered : " << min<uint64_t>(traceTotal_, trace_.size()) << "\n";
+        cout << setprecision(2);
+    }
+
+    // Write buffered spans, oldest first, in Chrome trace event format
+    bool dumpChromeTrace(const string& path) const {
+        ofstream out(path);
+        if (!out) return false;
+        size_t n = (size_t)min<uint64_t>(traceTotal_, trace_.size());
+        size_t first = traceTotal_ > trace_.size() ? traceNext_ : 0;
+        out << "{\"traceEvents\":[";
+        for (size_t i = 0; i < n; ++i) {
+            const Span &sp = trace_[(first + i) % trace_.size()];
+            out << (i ? ",\n" : "\n") << "{\"name\":\"" << lotOpName(sp.op) << "\",\"cat\":\"lot\",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+                << ",\"ts\":" << fixed << setprecision(3) << sp.startNs / 1000.0 << ",\"dur\":" << sp.durNs / 1000.0 << "}";
+        }
+        out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+        return (bool)out;
+    }
+};
+
+// Times the enclosing scope into Instrumentation when it is enabled
+class OpTimer {
+private:
+    Instrumentation* instr_;
+    LotOp op_;
+    int64_t start_;
+public:
+    OpTimer(Instrumentation& instr, LotOp op)
+        : instr_(instr.enabled() ? &instr : nullptr), op_(op), start_(instr_ ? Instrumentation::nowNs() : 0) {}
+    ~OpTimer() { if (instr_) instr_->recordOp(op_, start_, Instrumentation::nowNs()); }
+    OpTimer(const OpTimer&) = delete;
+    OpTimer& operator=(const OpTimer&) = delete;
+};
+
+/* Hot-path consistency checks. Compiled in by default (and out under
+   NDEBUG); -DPARKING_DEBUG_INVARIANTS=0/1 overrides. A failed check names
+   the invariant and aborts. ParkingLot::audit() is the full, always
+   available version of these checks.
+*/
+#ifndef PARKING_DEBUG_INVARIANTS
+#ifdef NDEBUG
+#define PARKING_DEBUG_INVARIANTS 0
+#else
+#define PARKING_DEBUG_INVARIANTS 1
+#endif
+#endif
+
+#if PARKING_DEBUG_INVARIANTS
+#define PL_INVARIANT(cond, what) do { if (!(cond)) { \
+        cerr << "❌ invariant failed: " << what << " (" #cond ", line " << __LINE__ << ")\n"; abort(); } } while (0)
+#else
+#define PL_INVARIANT(cond, what) ((void)0)
+#endif
+
+#if PARKING_INSTRUMENTATION
+#define PL_TIME_OP(op) OpTimer plOpTimer_(instr_, op)
+#define PL_COUNT(counter, n) instr_.count(counter, n)
+#else
+#define PL_TIME_OP(op) ((void)0)
+#define PL_COUNT(counter, n) ((void)0)
+#endif
+
+/* ------------------ LotMetrics ------------------
+   Gauges/counters the lot republishes after every state change with
+   relaxed atomic stores. Readers on other threads (metrics endpoint)
+   never lock and never slow the gate path.
+*/
+struct LotMetrics {
+    atomic<long long> slots[kMaxVehicleClasses];
+    atomic<long long> occupied[kMaxVehicleClasses];
+    atomic<long long> waitlistLength{0};
+    atomic<long long> vehiclesServed{0};
+    atomic<double> earnings{0.0};
+    atomic<long long> reservationsLive{0};
+    const Instrumentation* instr = nullptr;
+
+    LotMetrics() {
+        for (auto &a : slots) a.store(0, memory_order_relaxed);
+        for (auto &a : occupied) a.store(0, memory_order_relaxed);
+    }
+
+    // Prometheus text exposition format (version 0.0.4)
+    string renderPrometheus() const {
+        ostringstream o;
+        o << "# HELP parking_slots Slots per slot type.\n# TYPE parking_slots gauge\n";
+        for (int t = 0; t < vehicleClassCount(); ++t)
+            o << "parking_slots{type=\"" << vehicleTypeToStr((VehicleType)t) << "\"} " << slots[t].load(memory_order_relaxed) << "\n";
+        o << "# HELP parking_slots_occupied Occupied or held slots per slot type.\n# TYPE parking_slots_occupied gauge\n";
+        for (int t = 0; t < vehicleClassCount(); ++t)
+            o << "parking_slots_occupied{type=\"" << vehicleTypeToStr((VehicleType)t) << "\"} " << occupied[t].load(memory_order_relaxed) << "\n";
+        o << "# HELP parking_waitlist_length Vehicles waiting for a slot.\n# TYPE parking_waitlist_length gauge\n"
+          << "parking_waitlist_length " << waitlistLength.load(memory_order_relaxed) << "\n";
+        o << "# HELP parking_reservations_live Reservations booked or holding a slot.\n# TYPE parking_reservations_live gauge\n"
+          << "parking_reservations_live " << reservationsLive.load(memory_order_relaxed) << "\n";
+        o << "# HELP parking_vehicles_served_total Tickets issued.\n# TYPE parking_vehicles_served_total counter\n"
+          << "parking_vehicles_served_total " << vehiclesServed.load(memory_order_relaxed) << "\n";
+        o << fixed << setprecision(2);
+        o << "# HELP parking_earnings_rupees_total Fees collected.\n# TYPE parking_earnings_rupees_total counter\n"
+          << "parking_earnings_rupees_total " << earnings.load(memory_order_relaxed) << "\n";
+        if (instr) {
+            o << setprecision(9);
+            o << "# HELP parking_operation_latency_seconds Lot operation latency (recorded while instrumentation is on).\n"
+              << "# TYPE parking_operation_latency_seconds histogram\n";
+            for (int op = 0; op < kLotOpCount; ++op) {
+                const auto &sh = instr->shared((LotOp)op);
+                uint64_t count = sh.count.load(memory_order_acquire);
+                uint64_t cum = 0;
+                string name = lotOpName((LotOp)op);
+                for (int b = 0; b <= kPromLatencyBuckets; ++b) {
+                    cum += sh.buckets[b].load(memory_order_relaxed);
+                    o << "parking_operation_latency_seconds_bucket{op=\"" << name << "\",le=\"";
+                    if (b < kPromLatencyBuckets) o << kPromLatencyBoundsNs[b] / 1e9; else o << "+Inf";
+                    o << "\"} " << (b < kPromLatencyBuckets ? cum : max(cum, count)) << "\n";
+                }
+                o << "parking_operation_latency_seconds_sum{op=\"" << name << "\"} " << sh.sumNs.load(memory_order_relaxed) / 1e9 << "\n"
+                  << "parking_operation_latency_seconds_count{op=\"" << name << "\"} " << max(cum, count) << "\n";
+            }
+        }
+        return o.str();
+    }
+};
+
+/* ------------------ MetricsServer ------------------
+   Minimal HTTP/1.0 endpoint serving LotMetrics at GET /metrics, plus any
+   text pages added with addPage() (rendered on the server thread, so a
+   page must not touch a lot other threads write; see LotSnapshots).
+   One background thread, non-blocking sockets driven by epoll; each
+   connection is answered once and closed. stop() wakes the loop through
+   an eventfd. Linux only.
+*/
+class MetricsServer {
+private:
+    struct Conn { string in, out; size_t sent = 0; };
+    const LotMetrics* metrics_ = nullptr;
+    vector<pair<string, function<string()>>> pages_;   // path -> renderer
+    int listenFd_ = -1, epollFd_ = -1, wakeFd_ = -1;
+    thread worker_;
+    atomic<bool> running_{false};
+
+    static void setNonBlocking(int fd) { fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK); }
+
+    // "GET <path> " or "GET <path>?..."
+    static bool requests(const string& request, const string& path) {
+        string get = "GET " + path;
+        return request.compare(0, get.size(), get) == 0 && request.size() > get.size()
+               && (request[get.size()] == ' ' || request[get.size()] == '?');
+    }
+
+    string respond(const string& request) const {
+        bool isMetrics = requests(request, "/metrics"), found = isMetrics;
+        string body;
+        if (isMetrics) body = metrics_->renderPrometheus();
+        for (const auto &pg : pages_)
+            if (!found && requests(request, pg.first)) { body = pg.second(); found = true; }
+        if (!found) body = "not found\n";
+        ostringstream o;
+        o << "HTTP/1.0 " << (found ? "200 OK" : "404 Not Found") << "\r\n"
+          << "Content-Type: " << (isMetrics ? "text/plain; version=0.0.4" : "text/plain; charset=utf-8") << "\r\n"
+          << "Content-Length: " << body.size() << "\r\nConnection: close\r\n\r\n" << body;
+        return o.str();
+    }
+
+    void closeConn(int fd, unordered_map<int, Conn>& conns) {
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        conns.erase(fd);
+    }
+
+    void loop() {
+        unordered_map<int, Conn> conns;
+        epoll_event events[64];
+        while (running_.load(memory_order_acquire)) {
+            int n = epoll_wait(epollFd_, events, 64, -1);
+            for (int i = 0; i < n; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == wakeFd_) continue;
+                if (fd == listenFd_) {
+                    while (true) {
+                        int c = accept(listenFd_, nullptr, nullptr);
+                        if (c < 0) break;
+                        setNonBlocking(c);
+                        epoll_event ev{};
+                        ev.events = EPOLLIN;
+                        ev.data.fd = c;
+                        epoll_ctl(epollFd_, EPOLL_CTL_ADD, c, &ev);
+                        conns[c] = Conn{};
+                    }
+                    continue;
+                }
+                auto it = conns.find(fd);
+                if (it == conns.end()) continue;
+                Conn &cn = it->second;
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) { closeConn(fd, conns); continue; }
+                if (cn.out.empty() && (events[i].events & EPOLLIN)) {
+                    char buf[2048];
+                    ssize_t r;
+                    while ((r = read(fd, buf, sizeof(buf))) > 0) cn.in.append(buf, (size_t)r);
+                    if (r == 0 && cn.in.find("\r\n\r\n") == string::npos) { closeConn(fd, conns); continue; }
+                    if (cn.in.find("\r\n\r\n") == string::npos && cn.in.size() < 8192) continue;
+                    cn.out = respond(cn.in);
+                    epoll_event ev{};
+                    ev.events = EPOLLOUT;
+                    ev.data.fd = fd;
+                    epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev);
+                }
+                if (!cn.out.empty()) {
+                    ssize_t w = 0;
+                    while (cn.sent < cn.out.size() && (w = send(fd, cn.out.data() + cn.sent, cn.out.size() - cn.sent, MSG_NOSIGNAL)) > 0)
+                        cn.sent += (size_t)w;
+                    bool failed = w < 0 && errno != EAGAIN && errno != EWOULDBLOCK;   // peer gone (no SIGPIPE)
+                    if (cn.sent == cn.out.size() || failed) closeConn(fd, conns);
+                }
+            }
+        }
+        for (auto &kv : conns) close(kv.first);
+    }
+
+public:
+    ~MetricsServer() { stop(); }
+
+    bool running() const { return running_.load(); }
+
+    // Serve render() at GET path; add before start()
+    void addPage(const string& path, function<string()> render) { pages_.emplace_back(path, move(render)); }
+
+    // Listen on 127.0.0.1:port (port 0 picks a free one; see port())
+    bool start(const LotMetrics& metrics, int port) {
+        if (running()) return false;
+        metrics_ = &metrics;
+        listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenFd_ < 0) return false;
+        int one = 1;
+        setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::bind(listenFd_, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd_, 64) < 0) {
+            close(listenFd_); listenFd_ = -1;
+            return false;
+        }
+        setNonBlocking(listenFd_);
+        epollFd_ = epoll_create1(0);
+        wakeFd_ = eventfd(0, EFD_NONBLOCK);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = listenFd_;
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, listenFd_, &ev);
+        ev.data.fd = wakeFd_;
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &ev);
+        running_.store(true);
+        worker_ = thread(&MetricsServer::loop, this);
+        return true;
+    }
+
+    int port() const {
+        sockaddr_in addr{};
+        socklen_t len = sizeof(addr);
+        if (listenFd_ < 0 || getsockname(listenFd_, (sockaddr*)&addr, &len) < 0) return -1;
+        return ntohs(addr.sin_port);
+    }
+
+    void stop() {
+        if (!running()) return;
+        running_.store(false, memory_order_release);
+        uint64_t one = 1;
+        if (write(wakeFd_, &one, sizeof(one)) < 0) { /* loop also exits on next event */ }
+        if (worker_.joinable()) worker_.join();
+        close(listenFd_); close(epollFd_); close(wakeFd_);
+        listenFd_ = epollFd_ = wakeFd_ = -1;
+    }
+};
+
+/* ------------------ ExportHeader ------------------
+   Fixed 128-byte header at the start of a binary export (little-endian).
+   Every column is a plain array starting at an 8-byte aligned offset,
+   so offline tools can mmap the file and cast pointers directly:
+    slot_type  : uint8_t [slotCount]
+    slot_occ   : uint8_t [slotCount]      (1 = occupied)
+    ticket_no  : uint64_t[slotCount]      (numeric part of "T<n>", 0 if free)
+    vehicle_off: uint32_t[slotCount + 1]  (offsets into vehicle_blob)
+    vehicle_blob: char[]                  (concatenated vehicle IDs, no NULs)
+    wait_type  : uint8_t [waitCount]
+    wait_off   : uint32_t[waitCount + 1]  (offsets into wait_blob)
+    wait_blob  : char[]
+    stats      : ExportStats
+*/
+struct ExportStats {
+    int64_t totalVehiclesServed;
+    double totalEarnings;
+    int64_t ticketCounter;
+    uint32_t typeCount;      // classes in use (leading entries of ratePerHour)
+    uint32_t reserved;
+    double ratePerHour[kMaxVehicleClasses];   // indexed by VehicleType ordinal
+};
+
+struct ExportHeader {
+    char magic[8];           // "PLEXPRT1"
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t slotCount;
+    uint64_t waitCount;
+    uint64_t offSlotType;
+    uint64_t offSlotOcc;
+    uint64_t offTicketNo;
+    uint64_t offVehicleOff;
+    uint64_t offVehicleBlob;
+    uint64_t offWaitType;
+    uint64_t offWaitOff;
+    uint64_t offWaitBlob;
+    uint64_t offStats;
+    uint64_t fileSize;
+    uint64_t reserved[2];    // zero; room for future columns
+};
+static_assert(sizeof(ExportHeader) == 128, "ExportHeader layout must stay fixed");
+
+/* ------------------ LotEvent ------------------
+   One entry of the change feed. Trivially copyable so it can live in the
+   lock-free ring below.
+   seq      : 1-based position in the stream (gap-free per lot)
+   kind     : what happened
+   vtype    : vehicle/slot type involved
+   slotIndex: 0-based slot, -1 when not applicable (e.g. Waitlisted)
+   value    : fee for SlotReleased, new rate for RateChanged, else 0
+   vehicleID: NUL-terminated, truncated to fit
+*/
+enum class LotEventKind : uint8_t { SlotAssigned, SlotReleased, Waitlisted, WaitlistPromoted, RateChanged,
+                                    ReservationHeld, ReservationReleased, SlotOpened, SlotClosed, SlotRetyped,
+                                    WaitlistLeft };
+
+static string eventKindToStr(LotEventKind k) {
+    switch (k) {
+        case LotEventKind::SlotAssigned:        return "SlotAssigned";
+        case LotEventKind::SlotReleased:        return "SlotReleased";
+        case LotEventKind::Waitlisted:          return "Waitlisted";
+        case LotEventKind::WaitlistPromoted:    return "WaitlistPromoted";
+        case LotEventKind::RateChanged:         return "RateChanged";
+        case LotEventKind::ReservationHeld:     return "ReservationHeld";
+        case LotEventKind::SlotOpened:          return "SlotOpened";
+        case LotEventKind::SlotClosed:          return "SlotClosed";
+        case LotEventKind::SlotRetyped:         return "SlotRetyped";
+        case LotEventKind::WaitlistLeft:        return "WaitlistLeft";
+        default:                                return "ReservationReleased";
+    }
+}
+
+struct LotEvent {
+    uint64_t seq = 0;
+    LotEventKind kind = LotEventKind::SlotAssigned;
+    VehicleType vtype = VehicleType::CAR;
+    int32_t slotIndex = -1;
+    double value = 0.0;
+    char vehicleID[32] = {0};
+};
+
+/* ------------------ EventRing ------------------
+   Single-producer / multi-consumer ring of LotEvents. The producer (the lot)
+   never waits: each cell is guarded by its own seqlock, and a consumer that
+   falls more than 'capacity' events behind simply finds its cell overwritten
+   and skips ahead, counting what it lost. The payload is stored as relaxed
+   atomic words, so a read that overlaps a write is a retry, never a race.
+*/
+static_assert(is_trivially_copyable<LotEvent>::value && sizeof(LotEvent) % sizeof(uint64_t) == 0,
+              "LotEvent is copied through the ring as whole words");
+
+class EventRing {
+private:
+    static const size_t kWords = sizeof(LotEvent) / sizeof(uint64_t);
+    struct Cell {
+        atomic<uint64_t> version{0};   // odd while the producer is writing
+        atomic<uint64_t> words[kWords] = {};
+    };
+    vector<Cell> cells_;
+    uint64_t mask_;
+    atomic<uint64_t> published_{0};    // seq of the last fully written event
+
+public:
+    explicit EventRing(size_t capacityPow2 = 4096) : cells_(capacityPow2), mask_(capacityPow2 - 1) {}
+
+    size_t capacity() const { return cells_.size(); }
+    uint64_t lastSeq() const { return published_.load(memory_order_acquire); }
+
+    // Producer side: stamp the next sequence number and publish
+    void publish(LotEvent ev) {
+        uint64_t seq = published_.load(memory_order_relaxed) + 1;
+        ev.seq = seq;
+        Cell &c = cells_[seq & mask_];
+        uint64_t v = c.version.load(memory_order_relaxed);
+        c.version.store(v + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);   // odd version is visible before any word
+        uint64_t w[kWords];
+        memcpy(w, &ev, sizeof(ev));
+        for (size_t i = 0; i < kWords; ++i) c.words[i].store(w[i], memory_order_relaxed);
+        c.version.store(v + 2, memory_order_release);
+        published_.store(seq, memory_order_release);
+    }
+
+    // Consumer side: copy event 'seq' into out.
+    // Returns 1 on success, 0 if not yet published, -1 if already overwritten.
+    int read(uint64_t seq, LotEvent& out) const {
+        if (seq > lastSeq()) return 0;
+        const Cell &c = cells_[seq & mask_];
+        while (true) {
+            uint64_t v1 = c.version.load(memory_order_acquire);
+            if (v1 & 1) continue;          // producer mid-write, retry
+            uint64_t w[kWords];
+            for (size_t i = 0; i < kWords; ++i) w[i] = c.words[i].load(memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);   // words are read before the version re-check
+            if (c.version.load(memory_order_relaxed) != v1) continue;
+            memcpy(&out, w, sizeof(out));
+            if (out.seq == seq) return 1;
+            return out.seq > seq ? -1 : 0;
+        }
+    }
+};
+
+/* ------------------ EventSubscriber ------------------
+   A consumer cursor over an EventRing. Each subscriber advances at its own
+   pace; lost() counts events skipped because the ring wrapped past it.
+*/
+class EventSubscriber {
+private:
+    const EventRing* ring_;
+    uint64_t next_;
+    uint64_t lost_ = 0;
+public:
+    EventSubscriber(const EventRing& ring, uint64_t firstSeq) : ring_(&ring), next_(firstSeq) {}
+
+    // Fetch the next event; false when caught up
+    bool poll(LotEvent& out) {
+        while (true) {
+            int r = ring_->read(next_, out);
+            if (r == 1) { ++next_; return true; }
+            if (r == 0) return false;
+            // Overrun: jump to the oldest event still in the ring
+            uint64_t last = ring_->lastSeq();
+            uint64_t oldest = last >= ring_->capacity() ? last - ring_->capacity() + 1 : 1;
+            if (oldest <= next_) oldest = next_ + 1;
+            lost_ += oldest - next_;
+            next_ = oldest;
+        }
+    }
+    uint64_t nextSeq() const { return next_; }
+    uint64_t lost() const { return lost_; }
+};
+
+/* ------------------ LotResult ------------------
+   Outcome of an entry/exit/query, for callers that are not the console
+   (gate protocol, batch drivers).
+   slotIndex    : 0-based first bay, -1 if none
+   fee          : amount charged (exit only)
+   waitPosition : 1-based waitlist position when WAITLISTED
+*/
+/* PLATE_CORRECTED  : exit matching released a plate that differs from the
+                      one read only by OCR confusions; plate names it
+   AMBIGUOUS_PLATE  : exit matching found near plates but none it may take
+                      on its own; nothing was released, candidates ranks them
+   LEFT_WAITLIST    : a waiting entry ended without a slot (the vehicle left
+                      the waitlist or its promotion subscription was dropped) */
+enum class LotStatus : uint8_t { OK = 0, WAITLISTED = 1, NOT_FOUND = 2, DUPLICATE = 3, INVALID = 4,
+                                 PLATE_CORRECTED = 5, AMBIGUOUS_PLATE = 6, LEFT_WAITLIST = 7 };
+
+struct LotResult {
+    LotStatus status = LotStatus::OK;
+    int slotIndex = -1;
+    double fee = 0.0;
+    size_t waitPosition = 0;
+    string plate{};                                // PLATE_CORRECTED / AMBIGUOUS_PLATE: plate exited / best candidate
+    vector<PlateMatcher::Candidate> candidates{};  // AMBIGUOUS_PLATE, nearest first
+};
+
+/* ------------------ Promotion notifications ------------------
+   A waitlisted driver (or a notification service acting for them) can
+   subscribe to "your slot is ready". On promotion the subscription is
+   found with one hash lookup and queued; callbacks run and eventfds are
+   signalled only after the lot operation has finished, so subscribers
+   may call back into the lot and never run inside its critical section.
+   eventFd : if >= 0, slotIndex + 1 is added to this eventfd counter
+   A subscription removed before promotion (leaveWaitlist,
+   unsubscribePromotion) gets one last callback with slotIndex -1 and an
+   empty ticketID, so a waiter parked on it is never stranded; eventfds
+   are not signalled for it.
+*/
+struct PromotionNotice {
+    string vehicleID;
+    VehicleType vtype;
+    int slotIndex;
+    string ticketID;
+};
+using PromotionCallback = function<void(const PromotionNotice&)>;
+
+struct PromotionSubscription {
+    PromotionCallback callback;
+    int eventFd = -1;
+};
+
+/* ------------------ AuditReport ------------------
+   Result of ParkingLot::audit().
+   checked   : slots, map entries and waitlist entries examined
+   violations: invariants found broken
+   problems  : one line per violation (first kMaxProblems kept)
+*/
+struct AuditReport {
+    static const size_t kMaxProblems = 20;
+    size_t checked = 0;
+    size_t violations = 0;
+    vector<string> problems;
+
+    bool ok() const { return violations == 0; }
+    void fail(const string& what) {
+        ++violations;
+        if (problems.size() < kMaxProblems) problems.push_back(what);
+    }
+    void display() const {
+        if (ok()) { cout << "✅ Audit passed (" << checked << " items checked).\n"; return; }
+        cout << "❌ Audit found " << violations << " problem(s) in " << checked << " items:\n";
+        for (const auto &p : problems) cout << "  - " << p << "\n";
+        if (violations > problems.size()) cout << "  ... " << (violations - problems.size()) << " more\n";
+    }
+};
+
+/* ------------------ LotDigest ------------------
+   Incremental XOR checksums kept in step with every change to the lot, so
+   a background auditor can verify slots a chunk at a time instead of
+   stopping the lot for a full pass.
+   freeSum_   : per chunk of kChunk slots, XOR of freeKey(idx) over indices
+                sitting in a free pool
+   parkedSum_ : per chunk, XOR of parkedKey(head, vehicleID) over the head
+                slot of every parked vehicle
+   parked_/map_: the same parked keys XORed over the whole lot and over
+                vehicleToSlot_ entries; equal whenever map and slots agree
+   vehicles_  : parked vehicle count, compared with the map's size
+   XOR makes every update an O(1) toggle and the sums order-independent.
+*/
+class LotDigest {
+public:
+    static const int kChunk = 4096;
+
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+    static uint64_t freeKey(int idx) { return mix((uint64_t)idx + 0x9e3779b97f4a7c15ULL); }
+    static uint64_t parkedKey(int idx, const string& vehicleID) {
+        uint64_t h = 1469598103934665603ULL;
+        for (unsigned char c : vehicleID) { h ^= c; h *= 1099511628211ULL; }
+        return mix(h ^ ((uint64_t)idx << 32 | (uint32_t)idx));
+    }
+
+    size_t chunks() const { return freeSum_.size(); }
+    uint64_t freeSum(size_t c) const { return c < freeSum_.size() ? freeSum_[c] : 0; }
+    uint64_t parkedSum(size_t c) const { return c < parkedSum_.size() ? parkedSum_[c] : 0; }
+    uint64_t parkedTotal() const { return parked_; }
+    uint64_t mapTotal() const { return map_; }
+    size_t vehicles() const { return vehicles_; }
+
+    void resize(size_t slots) {
+        size_t n = (slots + kChunk - 1) / kChunk;
+        freeSum_.resize(n, 0);
+        parkedSum_.resize(n, 0);
+    }
+    void clear() { freeSum_.clear(); parkedSum_.clear(); parked_ = map_ = 0; vehicles_ = 0; }
+
+    void toggleFree(int idx) { grow(idx); freeSum_[idx / kChunk] ^= freeKey(idx); }
+    void park(int idx, const string& vehicleID) { toggleParked(idx, vehicleID); ++vehicles_; }
+    void unpark(int idx, const string& vehicleID) { toggleParked(idx, vehicleID); --vehicles_; }
+    void toggleMap(int idx, const string& vehicleID) { map_ ^= parkedKey(idx, vehicleID); }
+
+private:
+    vector<uint64_t> freeSum_, parkedSum_;
+    uint64_t parked_ = 0, map_ = 0;
+    size_t vehicles_ = 0;
+
+    void grow(int idx) { if ((size_t)idx / kChunk >= freeSum_.size()) resize((size_t)idx + 1); }
+    void toggleParked(int idx, const string& vehicleID) {
+        grow(idx);
+        uint64_t k = parkedKey(idx, vehicleID);
+        parkedSum_[idx / kChunk] ^= k;
+        parked_ ^= k;
+    }
+};
+
+/* ------------------ ParkingLot ------------------
+   Encapsulates all data structures and operations:
+    - slots_           : PagedVector<Slot> (main storage)
+    - freePools_       : one SlotAllocator of free slot indices per type (see strategies)
+    - vehicleToSlot_   : VehicleMap vehicleID -> slot index
+    - plateIndex_      : optional PlateIndex over the same IDs (partial-plate search)
+    - plateMatcher_    : optional PlateMatcher over the same IDs (misread plates at exit)
+    - waitlist_        : deque<WaitEntry> FIFO (IDs indexed in waitlisted_)
+    - rates & stats
+    - events_          : EventRing change feed of slot/waitlist/rate transitions
+    - digest_          : LotDigest checksums over free pools, parked slots and the map
+*/
+class ParkingLot {
+private:
+    PagedVector<Slot> slots_;
+    unique_ptr<SlotAllocator> freePools_[kMaxVehicleClasses];  // indexed by slot VehicleType
+    array<FreeRunIndex, kMaxVehicleClasses> runIndex_;  // free runs, only for slot types used by multi-bay vehicles
+    int slotsOfType_[kMaxVehicleClasses] = {0};  // total slots per slot type
+    // Optional garage topology and its free-capacity summary: free slots per
+    // zone and per (level, slot type), plus a free bitmap for in-zone lookup.
+    // The site-level count is the pool size. Kept in step by take/free.
+    shared_ptr<const GarageTopology> topology_;
+    vector<int> zoneFree_;
+    vector<int> levelFree_;                       // level * kMaxVehicleClasses + slot type
+    PagedVector<uint64_t> freeBits_;
+    int entryGate_ = -1;                          // gate of the entry being served, -1 = none
+    AllocationStrategy strategy_ = AllocationStrategy::LOWEST_INDEX;
+    int slotsPerLevel_ = 50;
+    shared_ptr<const vector<int>> gateDistance_;  // per slot, for NEAREST_GATE (allocators and forks share it)
+    shared_ptr<const vector<int>> exitDistance_;  // per slot, for NEAREST_EXIT
+    bool verbose_ = true;                         // print receipts/tickets
+    // Compatible-slot fallback per vehicle type: when its own pool is empty the
+    // vehicle may take a slot of fallbackType_ (-1 = none), as long as more than
+    // fallbackReserve_ slots of that type stay free for their own vehicles.
+    array<int, kMaxVehicleClasses> fallbackType_ = perVehicleType(-1);
+    array<size_t, kMaxVehicleClasses> fallbackReserve_ = perVehicleType<size_t>(0);
+    VehicleMap vehicleToSlot_;          // vehicleID -> slot index
+    bool plateSearch_ = false;          // keep plateIndex_ in step with vehicleToSlot_
+    PlateIndex plateIndex_;             // parked plates by prefix / fragment
+    double exitMatchDistance_ = 0.0;    // > 0: an exit that misses tries plateMatcher_ (kept in step)
+    PlateMatcher plateMatcher_;         // parked plates by OCR-weighted edit distance
+    deque<WaitEntry> waitlist_;
+    unordered_set<string> waitlisted_;  // vehicle IDs in waitlist_, so a queued vehicle cannot enter twice
+    LotDigest digest_;                  // incremental checksums for chunked audits
+    long long ticketCounter_ = 0;
+
+    // Stats & rates
+    long long totalVehiclesServed_ = 0;
+    double totalEarnings_ = 0.0;
+    array<double, kMaxVehicleClasses> ratePerHour_ = defaultRates();
+
+    EventRing events_;
+
+    // Clock in minutes; wall clock unless replaced (e.g. by a simulator)
+    function<long long()> clock_ = [] {
+        return chrono::duration_cast<chrono::minutes>(chrono::system_clock::now().time_since_epoch()).count();
+    };
+
+    // Reservations: capacity per slot type over time, plus activation/expiry
+    // min-heaps keyed by time. Heap entries for cancelled reservations are
+    // skipped lazily when popped.
+    using TimeHeap = priority_queue<pair<long long,long long>, vector<pair<long long,long long>>, greater<pair<long long,long long>>>;
+    unordered_map<long long, Reservation> reservations_;
+    array<CapacityTimeline, kMaxVehicleClasses> bookings_;
+    TimeHeap activations_;                             // (start, id)
+    TimeHeap expiries_;                                // (end, id)
+    array<deque<long long>, kMaxVehicleClasses> pendingHolds_; // by slot type: started, waiting for a free slot
+    unordered_map<int, long long> heldSlots_;          // slot index -> reservation id
+    long long reservationCounter_ = 0;
+
+    CowBox<OccupancyForecaster> forecaster_;
+    CowBox<LotStatistics> stats_;
+    long long occupiedSlots_ = 0;
+
+    Instrumentation instr_;
+    LotMetrics metrics_;
+
+    // One-shot promotion subscriptions by vehicle ID, and notices waiting to
+    // be dispatched once the current operation completes
+    unordered_map<string, PromotionSubscription> promotionSubs_;
+    vector<pair<PromotionSubscription, PromotionNotice>> pendingNotices_;
+    bool deferNotices_ = false;
+
+    // Republish gauges for the metrics endpoint (a handful of relaxed stores)
+    void publishMetrics() {
+        for (int t = 0; t < vehicleClassCount(); ++t) {
+            metrics_.slots[t].store(slotsOfType_[t], memory_order_relaxed);
+            metrics_.occupied[t].store(slotsOfType_[t] - (long long)freePools_[t]->size(), memory_order_relaxed);
+        }
+        metrics_.waitlistLength.store((long long)waitlist_.size(), memory_order_relaxed);
+        metrics_.vehiclesServed.store(totalVehiclesServed_, memory_order_relaxed);
+        metrics_.earnings.store(totalEarnings_, memory_order_relaxed);
+        metrics_.reservationsLive.store((long long)reservations_.size(), memory_order_relaxed);
+    }
+
+    // Append one event to the change feed
+    void emit(LotEventKind kind, VehicleType vt, int slotIdx, const string& vehicleID, double value = 0.0) {
+        LotEvent ev;
+        ev.kind = kind;
+        ev.vtype = vt;
+        ev.slotIndex = slotIdx;
+        ev.value = value;
+        size_t len = min(vehicleID.size(), sizeof(ev.vehicleID) - 1);
+        memcpy(ev.vehicleID, vehicleID.data(), len);
+        ev.vehicleID[len] = '\0';
+        events_.publish(ev);
+        publishMetrics();
+    }
+
+    // Generate next ticket id
+    string nextTicketID() { return "T" + to_string(++ticketCounter_); }
+
+    // Numeric part of a ticket id ("T42" -> 42), 0 for an empty id
+    static uint64_t ticketNumber(const string& tid) {
+        return tid.size() > 1 ? stoull(tid.substr(1)) : 0;
+    }
+
+    // Round a file offset up to the next 8-byte boundary
+    static uint64_t align8(uint64_t off) { return (off + 7) & ~uint64_t(7); }
+
+    // Pad the stream with zeros up to 'off'
+    static void padTo(ofstream& out, uint64_t off) {
+        static const char zeros[8] = {0};
+        uint64_t pos = (uint64_t)out.tellp();
+        if (off > pos) out.write(zeros, (streamsize)(off - pos));
+    }
+
+    // Escape a CSV field only when needed (IDs are user supplied)
+    static string csvField(const string& f) {
+        if (f.find_first_of(",\"\n") == string::npos) return f;
+        string q = "\"";
+        for (char c : f) { if (c == '"') q += '"'; q += c; }
+        return q + "\"";
+    }
+
+    // Return free pool for a vehicle type
+    SlotAllocator& poolFor(VehicleType vt) { return *freePools_[(int)vt]; }
+    const SlotAllocator& poolFor(VehicleType vt) const { return *freePools_[(int)vt]; }
+
+    unique_ptr<SlotAllocator> makeAllocator() const {
+        switch (strategy_) {
+            case AllocationStrategy::NEAREST_GATE: return make_unique<DistanceAllocator>(gateDistance_, true);
+            case AllocationStrategy::NEAREST_EXIT: return make_unique<DistanceAllocator>(exitDistance_, false);
+            case AllocationStrategy::ROUND_ROBIN:  return make_unique<RoundRobinAllocator>();
+            case AllocationStrategy::LEVEL_FILL:   return make_unique<LevelFillAllocator>(slotsPerLevel_);
+            default:                               return make_unique<LowestIndexAllocator>();
+        }
+    }
+
+    bool usesDistanceTables() const {
+        return strategy_ == AllocationStrategy::NEAREST_GATE || strategy_ == AllocationStrategy::NEAREST_EXIT;
+    }
+
+    // Default distance tables when none were supplied: gate at slot 1, exit
+    // after the last slot. Tables are never modified once built (forks share
+    // them); slots added later are keyed by DistanceAllocator.
+    void ensureDistanceTables() {
+        int n = (int)slots_.size();
+        if (!gateDistance_) {
+            auto d = make_shared<vector<int>>(n);
+            for (int i = 0; i < n; ++i) (*d)[i] = i;
+            gateDistance_ = d;
+        }
+        if (!exitDistance_) {
+            auto d = make_shared<vector<int>>(n);
+            for (int i = 0; i < n; ++i) (*d)[i] = n - 1 - i;
+            exitDistance_ = d;
+        }
+    }
+
+    // Slot type a vehicle of type vt may fall back to right now, -1 if none
+    int fallbackFor(VehicleType vt) const {
+        int ft = fallbackType_[(int)vt];
+        if (ft < 0) return -1;
+        return freePools_[ft]->size() > fallbackReserve_[(int)vt] ? ft : -1;
+    }
+
+    // Update the topology summary for one slot changing free state
+    // Slots added after the layout belong to no zone and a retyped slot
+    // leaves its zone's routing; both are still served from the pool.
+    void markTopology(int idx, bool free) {
+        if (!topology_ || idx >= topology_->slotCount()) return;
+        int z = topology_->zoneOf(idx);
+        const auto &zone = topology_->zones()[z];
+        int d = free ? 1 : -1;
+        levelFree_[zone.level * kMaxVehicleClasses + (int)slots_[idx].type()] += d;
+        if (slots_[idx].type() != zone.type) return;
+        zoneFree_[z] += d;
+        if (free) freeBits_.mut(idx >> 6) |= 1ULL << (idx & 63);
+        else freeBits_.mut(idx >> 6) &= ~(1ULL << (idx & 63));
+    }
+
+    // Lowest free slot index in [lo, hi), -1 if none
+    int firstFree(int lo, int hi) const {
+        for (int w = lo >> 6; w <= (hi - 1) >> 6; ++w) {
+            uint64_t bits = freeBits_[w];
+            if (w == lo >> 6) bits &= ~0ULL << (lo & 63);
+            if (!bits) continue;
+            int idx = w * 64 + __builtin_ctzll(bits);
+            return idx < hi ? idx : -1;
+        }
+        return -1;
+    }
+
+    // A slot entered or left its free pool: topology summary and checksum
+    void poolChanged(int idx, bool free) {
+        digest_.toggleFree(idx);
+        markTopology(idx, free);
+    }
+
+    // Record a vehicle in the map (and its checksum)
+    void mapVehicle(const string& vehicleID, int slotIdx) {
+        vehicleToSlot_.set(vehicleID, slotIdx);
+        digest_.toggleMap(slotIdx, vehicleID);
+        if (plateSearch_) plateIndex_.insert(vehicleID);
+        if (exitMatchDistance_ > 0) plateMatcher_.insert(vehicleID);
+    }
+
+    // Take one free slot of slot type st, keeping the run index in step
+    int takeSlot(int st) {
+        PL_COUNT(LotCounter::PoolOps, 1);
+        int idx = freePools_[st]->acquire();
+        if (idx >= 0 && runIndex_[st].active()) runIndex_[st].set(idx, false);
+        if (idx >= 0) poolChanged(idx, false);
+        return idx;
+    }
+
+    // Take the free slot of slot type st nearest to a gate by descending the
+    // topology: levels nearest-first, then zones, skipping any with no room
+    int takeNearest(int st, int gate) {
+        if (freePools_[st]->empty()) return -1;
+        for (const auto &lr : topology_->route(gate)) {
+            if (levelFree_[lr.level * kMaxVehicleClasses + st] == 0) continue;
+            for (int z : lr.zones) {
+                const auto &zone = topology_->zones()[z];
+                if ((int)zone.type != st || zoneFree_[z] == 0) continue;
+                int idx = firstFree(zone.first, zone.first + zone.count);
+                PL_COUNT(LotCounter::PoolOps, 1);
+                freePools_[st]->erase(idx);
+                if (runIndex_[st].active()) runIndex_[st].set(idx, false);
+                poolChanged(idx, false);
+                return idx;
+            }
+        }
+        return -1;
+    }
+
+    // One slot of slot type st: routed from the entry gate when there is one
+    int takeFor(int st) {
+        return topology_ && entryGate_ >= 0 ? takeNearest(st, entryGate_) : takeSlot(st);
+    }
+
+    // Take the lowest run of k adjacent free slots of slot type st
+    int takeRun(int st, int k) {
+        int start = runIndex_[st].findRun(k);
+        if (start < 0) return -1;
+        PL_COUNT(LotCounter::PoolOps, k);
+        for (int i = start; i < start + k; ++i) {
+            freePools_[st]->erase(i);
+            runIndex_[st].set(i, false);
+            poolChanged(i, false);
+        }
+        return start;
+    }
+
+    // Return one slot to its free pool; a closed slot leaves service instead
+    void freeSlot(int idx) {
+        int st = (int)slots_[idx].type();
+        if (slots_[idx].closed()) { --slotsOfType_[st]; return; }
+        PL_COUNT(LotCounter::PoolOps, 1);
+        freePools_[st]->release(idx);
+        if (runIndex_[st].active()) runIndex_[st].set(idx, true);
+        poolChanged(idx, true);
+    }
+
+    // First slot for a vehicle of type vt (its own pool, then any fallback), -1 if none
+    int allocateFor(VehicleType vt) {
+        int st = (int)slotTypeFor(vt);
+        int bays = baysFor(vt);
+        if (bays > 1) return takeRun(st, bays);
+        int idx = takeFor(st);
+        if (idx < 0) {
+            int ft = fallbackFor(vt);
+            if (ft >= 0) idx = takeFor(ft);
+        }
+        return idx;
+    }
+
+    // Mark every bay of a ticket occupied
+    void occupy(const Ticket& t) {
+        auto shared = make_shared<const Ticket>(t);
+        for (int i = t.slotIndex; i < t.slotIndex + t.bays; ++i) slots_.mut(i).assignTicket(shared);
+        digest_.park(t.slotIndex, t.vehicleID);
+        long long nowT = clock_();
+        forecaster_.mut().record(nowT, slots_[t.slotIndex].type(), t.bays);
+        occupiedSlots_ += t.bays;
+        LotStatistics &st = stats_.mut();
+        st.peakOccupied = max(st.peakOccupied, occupiedSlots_);
+        st.trackedUntil = max(st.trackedUntil, nowT);
+    }
+
+    // Slots of slot type st (reservation capacity)
+    int slotCount(int st) const { return slotsOfType_[st]; }
+
+    // Take a slot out of the free pool for a started reservation
+    bool holdSlot(Reservation& r) {
+        int idx = takeSlot((int)r.slotType);
+        if (idx < 0) return false;
+        r.slotIndex = idx;
+        r.state = Reservation::HELD;
+        heldSlots_[idx] = r.id;
+        emit(LotEventKind::ReservationHeld, r.vtype, idx, r.customer);
+        return true;
+    }
+
+    // Give a held slot back (no-show or cancellation)
+    void releaseHold(Reservation& r) {
+        heldSlots_.erase(r.slotIndex);
+        freeSlot(r.slotIndex);
+        emit(LotEventKind::ReservationReleased, r.vtype, r.slotIndex, r.customer);
+        r.slotIndex = -1;
+    }
+
+    // Bring reservations up to date with the clock: expire finished holds,
+    // retry pending holds (they outrank the waitlist), start due bookings.
+    void processReservations() {
+        if (reservations_.empty()) return;
+        long long now = clock_();
+        while (!expiries_.empty() && expiries_.top().first <= now) {
+            long long id = expiries_.top().second; expiries_.pop();
+            auto it = reservations_.find(id);
+            if (it == reservations_.end()) continue;
+            Reservation &r = it->second;
+            if (r.state == Reservation::HELD) releaseHold(r);
+            bookings_[(int)r.slotType].book(r.start, r.end, -1);
+            reservations_.erase(it);
+        }
+        for (int t = 0; t < vehicleClassCount(); ++t) {
+            auto &pending = pendingHolds_[t];
+            while (!pending.empty()) {
+                auto it = reservations_.find(pending.front());
+                if (it == reservations_.end() || it->second.state != Reservation::BOOKED) { pending.pop_front(); continue; }
+                if (!holdSlot(it->second)) break;
+                pending.pop_front();
+            }
+        }
+        while (!activations_.empty() && activations_.top().first <= now) {
+            long long id = activations_.top().second; activations_.pop();
+            auto it = reservations_.find(id);
+            if (it == reservations_.end() || it->second.state != Reservation::BOOKED) continue;
+            Reservation &r = it->second;
+            if (!pendingHolds_[(int)r.slotType].empty() || !holdSlot(r)) pendingHolds_[(int)r.slotType].push_back(id);
+        }
+    }
+
+    // Drop vehicleID's promotion subscription; a callback still gets its
+    // slotIndex -1 notice so a suspended waiter resumes
+    bool cancelSubscription(const string& vehicleID, VehicleType vt) {
+        auto sub = promotionSubs_.find(vehicleID);
+        if (sub == promotionSubs_.end()) return false;
+        if (sub->second.callback)
+            pendingNotices_.emplace_back(PromotionSubscription{move(sub->second.callback), -1},
+                                         PromotionNotice{vehicleID, vt, -1, string()});
+        promotionSubs_.erase(sub);
+        return true;
+    }
+
+    // Give the waitlist front a slot if one fits now (or the given bays,
+    // already out of every pool); true if promoted
+    bool promoteWaitlistFront(int givenIdx = -1) {
+        if (waitlist_.empty()) return false;
+        WaitEntry front = waitlist_.front();
+        int newIdx = givenIdx >= 0 ? givenIdx : allocateFor(front.type);
+        if (newIdx < 0) return false;
+        waitlist_.pop_front();
+        waitlisted_.erase(front.vehicleID);
+        string newTicketID = nextTicketID();
+        Ticket nt(newTicketID, front.vehicleID, front.type, newIdx);
+        occupy(nt);
+        mapVehicle(front.vehicleID, newIdx);
+        totalVehiclesServed_++;
+        stats_.mut().waitTime.record((uint64_t)max(0LL, clock_() - front.since));
+        PL_COUNT(LotCounter::WaitlistPromotions, 1);
+        emit(LotEventKind::WaitlistPromoted, front.type, newIdx, front.vehicleID);
+        auto sub = promotionSubs_.find(front.vehicleID);
+        if (sub != promotionSubs_.end()) {
+            pendingNotices_.emplace_back(move(sub->second),
+                                         PromotionNotice{front.vehicleID, front.type, newIdx, newTicketID});
+            promotionSubs_.erase(sub);
+        }
+        if (verbose_) {
+            cout << "➡️ Freed slot " << (newIdx + 1) << " assigned to waitlisted vehicle \""
+                 << front.vehicleID << "\" | New Ticket: " << newTicketID << "\n";
+        }
+        return true;
+    }
+
+    /* Release a departing vehicle's bays and serve the waitlist as one step.
+       When the front vehicle fits the freed bays exactly (same slot type and
+       bay count, bays still in service) and no started reservation is
+       waiting for that type, the bays pass straight to it with no pool
+       round trip. Otherwise they go back to the pool, started reservations
+       take their turn, and the front is tried through allocateFor(), which
+       also covers fallbacks and runs. */
+    void releaseAndPromote(int slotIdx, int bays) {
+        int st = (int)slots_[slotIdx].type();
+        bool direct = !waitlist_.empty()
+                      && (int)slotTypeFor(waitlist_.front().type) == st
+                      && baysFor(waitlist_.front().type) == bays
+                      && pendingHolds_[st].empty();
+        for (int i = slotIdx; direct && i < slotIdx + bays; ++i) direct = !slots_[i].closed();
+        if (direct) {
+            promoteWaitlistFront(slotIdx);
+            return;
+        }
+        for (int i = slotIdx; i < slotIdx + bays; ++i) freeSlot(i);
+        processReservations();
+        promoteWaitlistFront();
+    }
+
+    // Handle to a parked vehicle: its map entry (erased on exit without a
+    // second lookup) and the slot it addresses
+    struct ParkedHandle {
+        size_t entry = VehicleMap::npos;
+        int slotIndex = -1;
+        explicit operator bool() const { return slotIndex >= 0; }
+    };
+
+    ParkedHandle findParked(const string& vehicleID) {
+        PL_COUNT(LotCounter::MapProbes, 1);
+        ParkedHandle h;
+        h.entry = vehicleToSlot_.locate(vehicleID);
+        if (h.entry != VehicleMap::npos) h.slotIndex = vehicleToSlot_.slotAt(h.entry);
+        return h;
+    }
+
+    // Remove a map entry that no longer addresses its vehicle, with its
+    // checksum and index entries
+    void unmapStale(ParkedHandle h, const string& vehicleID) {
+        digest_.toggleMap(h.slotIndex, vehicleID);
+        vehicleToSlot_.eraseAt(h.entry);
+        if (plateSearch_) plateIndex_.erase(vehicleID);
+        if (exitMatchDistance_ > 0) plateMatcher_.erase(vehicleID);
+    }
+
+    // Billed hours: minutes rounded up, minimum one hour
+    static long long billedHours(long long minutes) { return max(1LL, (max(0LL, minutes) + 59) / 60); }
+
+    void printReceipt(const string& vehicleID, const Ticket& t, VehicleType slotType,
+                      long long minutes, long long hours, double rate, double fee) const {
+        cout << fixed << setprecision(2);
+        cout << "\n🧾 Receipt\n"
+             << "  Vehicle : " << vehicleID << "\n"
+             << "  Slot    : " << (t.slotIndex + 1);
+        if (t.bays > 1) cout << "-" << (t.slotIndex + t.bays);
+        cout << " (" << vehicleTypeToStr(slotType) << ")\n"
+             << "  Duration: " << minutes << " minutes (" << hours << " hour(s) billed)\n"
+             << "  Rate/hr : Rs " << rate << "\n"
+             << "  Amount  : Rs " << fee << "\n";
+    }
+
+    // After capacity grows, promote as many waitlisted vehicles as now fit
+    void serveWaitlist() {
+        processReservations();
+        while (promoteWaitlistFront()) {}
+        if (!deferNotices_) dispatchNotifications();
+    }
+
+    // Lots at least this big build their pools on several threads
+    static const size_t kParallelBuildSlots = 1 << 20;
+
+    // Whether any vehicle type parks across several slots of slot type st
+    static bool hasMultiBayUsers(int st) {
+        for (int vt = 0; vt < vehicleClassCount(); ++vt)
+            if ((int)slotTypeFor((VehicleType)vt) == st && baysFor((VehicleType)vt) > 1) return true;
+        return false;
+    }
+
+    // Take a specific free slot out of its pool (and the run index/topology)
+    void withdrawSlot(int idx) {
+        int st = (int)slots_[idx].type();
+        PL_COUNT(LotCounter::PoolOps, 1);
+        freePools_[st]->erase(idx);
+        if (runIndex_[st].active()) runIndex_[st].set(idx, false);
+        poolChanged(idx, false);
+    }
+
+    // Rebuild every free pool (and run index) from current slot occupancy.
+    // Free indices are gathered per slot type in one pass, then each type's
+    // allocator and run index are built in O(n) from them; on big lots the
+    // types are built on separate threads (they share no state).
+    void rebuildPools() {
+        if (usesDistanceTables()) ensureDistanceTables();
+        int types = vehicleClassCount();
+        for (auto &c : slotsOfType_) c = 0;
+        vector<vector<int>> freeIdx(types);
+        int first[kMaxVehicleClasses], last[kMaxVehicleClasses];
+        for (int t = 0; t < types; ++t) first[t] = last[t] = -1;
+        for (int pass = 0; pass < 2; ++pass) {
+            for (const auto &s : slots_) {
+                int t = (int)s.type();
+                bool held = !heldSlots_.empty() && heldSlots_.count(s.index());
+                bool isFree = !s.occupied() && !s.closed() && !held;
+                if (pass == 0) {
+                    if (!s.closed() || s.occupied() || held) ++slotsOfType_[t];
+                    if (first[t] < 0) first[t] = s.index();
+                    last[t] = s.index();
+                } else if (isFree) {
+                    freeIdx[t].push_back(s.index());
+                }
+            }
+            if (pass == 0) for (int t = 0; t < types; ++t) freeIdx[t].reserve(slotsOfType_[t]);
+        }
+
+        auto buildType = [&](int st) {
+            freePools_[st] = makeAllocator();
+            freePools_[st]->bulkLoad(freeIdx[st]);
+            if (first[st] >= 0 && hasMultiBayUsers(st)) runIndex_[st].build(first[st], last[st] + 1 - first[st], freeIdx[st]);
+            else runIndex_[st].clear();
+        };
+        vector<int> busy;
+        for (int st = 0; st < types; ++st) if (first[st] >= 0) busy.push_back(st);
+        unsigned workers = min<unsigned>(thread::hardware_concurrency(), (unsigned)busy.size());
+        if (slots_.size() >= kParallelBuildSlots && workers > 1) {
+            vector<thread> pool;
+            atomic<size_t> next{0};
+            for (unsigned w = 0; w < workers; ++w)
+                pool.emplace_back([&] { for (size_t i; (i = next++) < busy.size(); ) buildType(busy[i]); });
+            for (auto &th : pool) th.join();
+        } else {
+            for (int st : busy) buildType(st);
+        }
+        for (int st = 0; st < kMaxVehicleClasses; ++st) {
+            if (st < types && first[st] >= 0) continue;
+            freePools_[st] = makeAllocator();
+            runIndex_[st].clear();
+        }
+
+        if (topology_) {
+            zoneFree_.assign(topology_->zones().size(), 0);
+            levelFree_.assign((size_t)topology_->levelCount() * kMaxVehicleClasses, 0);
+            freeBits_.assign((slots_.size() + 63) / 64, 0);
+            for (const auto &v : freeIdx) for (int idx : v) markTopology(idx, true);
+        }
+        digest_.clear();
+        digest_.resize(slots_.size());
+        for (const auto &v : freeIdx) for (int idx : v) digest_.toggleFree(idx);
+        for (const auto &s : slots_)
+            if (s.occupied() && s.getTicket().slotIndex == s.index()) digest_.park(s.index(), s.getTicket().vehicleID);
+        vehicleToSlot_.forEach([&](const string& id, int slot) { digest_.toggleMap(slot, id); });
+        stats_.mut().totalSlots = (long long)slots_.size();
+        publishMetrics();
+    }
+
+    // Copy-on-write copy for fork(): paged state shares its pages with o,
+    // allocators are cloned (their storage is paged too), small containers
+    // are copied. The change feed, instrumentation, metrics and promotion
+    // subscriptions start empty; a fork notifies nobody.
+    struct ForkTag {};
+    ParkingLot(const ParkingLot& o, ForkTag)
+        : slots_(o.slots_), runIndex_(o.runIndex_), topology_(o.topology_), zoneFree_(o.zoneFree_), levelFree_(o.levelFree_),
+          freeBits_(o.freeBits_), strategy_(o.strategy_), slotsPerLevel_(o.slotsPerLevel_),
+          gateDistance_(o.gateDistance_), exitDistance_(o.exitDistance_), verbose_(o.verbose_),
+          fallbackType_(o.fallbackType_), fallbackReserve_(o.fallbackReserve_), vehicleToSlot_(o.vehicleToSlot_),
+          plateSearch_(o.plateSearch_), plateIndex_(o.plateIndex_),
+          exitMatchDistance_(o.exitMatchDistance_), plateMatcher_(o.plateMatcher_), waitlist_(o.waitlist_), waitlisted_(o.waitlisted_), digest_(o.digest_), ticketCounter_(o.ticketCounter_),
+          totalVehiclesServed_(o.totalVehiclesServed_), totalEarnings_(o.totalEarnings_), ratePerHour_(o.ratePerHour_),
+          events_(256), clock_(o.clock_), reservations_(o.reservations_), bookings_(o.bookings_), activations_(o.activations_),
+          expiries_(o.expiries_), pendingHolds_(o.pendingHolds_), heldSlots_(o.heldSlots_), reservationCounter_(o.reservationCounter_),
+          forecaster_(o.forecaster_), stats_(o.stats_), occupiedSlots_(o.occupiedSlots_) {
+        for (int t = 0; t < kMaxVehicleClasses; ++t) {
+            freePools_[t] = o.freePools_[t]->clone();
+            slotsOfType_[t] = o.slotsOfType_[t];
+        }
+        metrics_.instr = &instr_;
+        publishMetrics();
+    }
+
+public:
+    ParkingLot() {
+        metrics_.instr = &instr_;
+        rebuildPools();
+    }
+
+    /* Copy-on-write snapshot for what-if runs. Costs one reference per page
+       (a 1M-slot lot has a few hundred) plus the waitlist and reservations;
+       after that each side copies a page the first time it writes to it.
+       Call it where the lot may be read (its owning thread or under its
+       lock); the fork can then move to any thread. */
+    unique_ptr<ParkingLot> fork() const { return unique_ptr<ParkingLot>(new ParkingLot(*this, ForkTag{})); }
+
+    // Pages of slot storage shared with forks (diagnostics)
+    size_t sharedSlotPages() const { return slots_.sharedPages(); }
+
+    // Initialize parking slots: contiguous blocks of car, bike, truck
+    void initialize(int numCars, int numBikes, int numTrucks) {
+        array<int, kMaxVehicleClasses> counts = perVehicleType(0);
+        counts[(int)VehicleType::CAR] = numCars;
+        counts[(int)VehicleType::BIKE] = numBikes;
+        counts[(int)VehicleType::TRUCK] = numTrucks;
+        initialize(counts);
+    }
+
+    // Initialize with counts per slot-owning type, laid out in type order
+    void initialize(const array<int, kMaxVehicleClasses>& counts) {
+        resetState();
+        topology_.reset();
+        gateDistance_.reset();
+        exitDistance_.reset();
+
+        size_t total = 0;
+        for (int t = 0; t < vehicleClassCount(); ++t) if (ownsSlots((VehicleType)t)) total += max(0, counts[t]);
+        slots_.reserve(total);
+        int idx = 0;
+        for (int t = 0; t < vehicleClassCount(); ++t) {
+            if (!ownsSlots((VehicleType)t)) continue;
+            for (int i = 0; i < counts[t]; ++i) slots_.emplace_back(idx++, (VehicleType)t);
+        }
+        rebuildPools();
+
+        if (verbose_) {
+            cout << "\n✅ Parking initialized: Total slots = " << slots_.size() << "  (";
+            bool first = true;
+            for (int t = 0; t < vehicleClassCount(); ++t) {
+                if (!ownsSlots((VehicleType)t)) continue;
+                cout << (first ? "" : ", ") << vehicleTypeToStr((VehicleType)t) << ": " << counts[t];
+                first = false;
+            }
+            cout << ")\n";
+        }
+        if (!deferNotices_) dispatchNotifications();
+    }
+
+    // Initialize from a garage layout: slots zone by zone, distance tables
+    // from the first gate (NEAREST_GATE) and the last gate (NEAREST_EXIT)
+    void initialize(shared_ptr<const GarageTopology> topo) {
+        resetState();
+        topology_ = move(topo);
+        slots_.reserve(topology_->slotCount());
+        for (const auto &z : topology_->zones())
+            for (int k = 0; k < z.count; ++k) slots_.emplace_back(z.first + k, z.type);
+        gateDistance_ = make_shared<vector<int>>(topology_->distancesFrom(0));
+        exitDistance_ = make_shared<vector<int>>(topology_->distancesFrom((int)topology_->gates().size() - 1));
+        rebuildPools();
+
+        if (verbose_) {
+            cout << "\n✅ Parking initialized: " << topology_->site() << ", " << topology_->levelCount() << " level(s), "
+                 << topology_->zones().size() << " zone(s), " << topology_->gates().size() << " gate(s), "
+                 << slots_.size() << " slots\n";
+        }
+        if (!deferNotices_) dispatchNotifications();
+    }
+
+    // Read a layout file and initialize from it; false (lot untouched) on error
+    bool loadLayout(const string& path) {
+        auto topo = make_shared<GarageTopology>();
+        string err;
+        if (!topo->loadFile(path, err)) {
+            if (verbose_) cout << "❗ Layout not loaded: " << err << "\n";
+            return false;
+        }
+        initialize(topo);
+        return true;
+    }
+
+private:
+    // Clear every vehicle, queue, reservation and statistic
+    void resetState() {
+        slots_.clear();
+        vehicleToSlot_.clear();
+        plateIndex_.clear();
+        plateMatcher_.clear();
+        pendingNotices_.clear();
+        for (const auto &w : waitlist_) cancelSubscription(w.vehicleID, w.type);   // waiters resume with LEFT_WAITLIST
+        waitlist_.clear();
+        waitlisted_.clear();
+        promotionSubs_.clear();
+        reservations_.clear();
+        heldSlots_.clear();
+        activations_ = TimeHeap();
+        expiries_ = TimeHeap();
+        for (auto &p : pendingHolds_) p.clear();
+        for (auto &b : bookings_) b.reset(clock_());
+        forecaster_.mut().reset();
+        LotStatistics &st = stats_.mut();
+        st = LotStatistics();
+        st.trackedSince = st.trackedUntil = clock_();
+        occupiedSlots_ = 0;
+        ticketCounter_ = 0;
+        totalVehiclesServed_ = 0;
+        totalEarnings_ = 0.0;
+    }
+
+public:
+    const GarageTopology* topology() const { return topology_.get(); }
+
+    // Free slots of slot type st on a level, O(1) (for the ramp signs)
+    int levelFreeCount(int level, VehicleType st) const {
+        if (!topology_ || level < 0 || level >= topology_->levelCount()) return 0;
+        return levelFree_[level * kMaxVehicleClasses + (int)st];
+    }
+
+    // Per-level free counts as shown on the ramp signs
+    void displayLevels() const {
+        if (!topology_) {
+            cout << "\nℹ️ No garage layout loaded (start with --layout FILE).\n";
+            return;
+        }
+        cout << "\n🏢 " << topology_->site() << " — free slots per level\n";
+        for (int l = 0; l < topology_->levelCount(); ++l) {
+            cout << "  " << topology_->levelName(l) << ":";
+            for (int t = 0; t < vehicleClassCount(); ++t) {
+                if (!ownsSlots((VehicleType)t)) continue;
+                int total = 0;
+                for (const auto &z : topology_->zones())
+                    if (z.level == l && (int)z.type == t) total += z.count;
+                if (total > 0) cout << "  " << vehicleTypeToStr((VehicleType)t) << " " << levelFreeCount(l, (VehicleType)t) << "/" << total;
+            }
+            cout << "\n";
+        }
+        cout << "  Gates:";
+        for (const auto &g : topology_->gates()) cout << " " << g.name << " (" << topology_->levelName(g.level) << ")";
+        cout << "\n";
+    }
+
+    // Select the allocation strategy; free pools are rebuilt in place,
+    // parked vehicles are not moved
+    void setStrategy(AllocationStrategy st) {
+        strategy_ = st;
+        rebuildPools();
+    }
+    AllocationStrategy strategy() const { return strategy_; }
+
+    // Level size used by LEVEL_FILL (takes effect on the next setStrategy/initialize)
+    void setSlotsPerLevel(int n) { slotsPerLevel_ = max(1, n); }
+
+    // Per-slot distance tables for NEAREST_GATE / NEAREST_EXIT (size must match slot count)
+    void setDistanceTables(vector<int> toGate, vector<int> toExit) {
+        gateDistance_ = make_shared<vector<int>>(move(toGate));
+        exitDistance_ = make_shared<vector<int>>(move(toExit));
+        rebuildPools();
+    }
+
+    // Allow vt to use 'larger' slots when its own are full, keeping 'reserve'
+    // of them free for their own type. Passing larger == vt disables fallback.
+    void setFallback(VehicleType vt, VehicleType larger, size_t reserve = 0) {
+        fallbackType_[(int)vt] = larger == vt ? -1 : (int)larger;
+        fallbackReserve_[(int)vt] = reserve;
+    }
+
+    /* Live capacity changes, each O(log n) per slot (amortized for adds):
+       parked vehicles, the waitlist and statistics are untouched. */
+
+    // Append count slots of slot type st; returns the first new index. New
+    // slots count as furthest from the gate and nearest the exit, and belong
+    // to no zone of the garage layout.
+    int addSlots(VehicleType st, int count) {
+        if (!ownsSlots(st) || count <= 0) return -1;
+        if (usesDistanceTables()) ensureDistanceTables();
+        int first = (int)slots_.size();
+        for (int k = 0; k < count; ++k) {
+            int idx = (int)slots_.size();
+            slots_.emplace_back(idx, st);
+            if (hasMultiBayUsers((int)st)) runIndex_[(int)st].cover(idx);
+            ++slotsOfType_[(int)st];
+            ++stats_.mut().totalSlots;
+            freeSlot(idx);
+            emit(LotEventKind::SlotOpened, st, idx, "");
+        }
+        serveWaitlist();
+        return first;
+    }
+
+    // Take a slot out of service. A free slot leaves at once; an occupied (or
+    // reservation-held) one drains: it is never reassigned and leaves service
+    // when vacated.
+    LotStatus decommissionSlot(int idx) {
+        if (idx < 0 || idx >= (int)slots_.size() || slots_[idx].closed()) return LotStatus::INVALID;
+        Slot &s = slots_.mut(idx);
+        bool inUse = s.occupied() || heldSlots_.count(idx);
+        if (!inUse) withdrawSlot(idx);
+        s.setClosed(true);
+        if (!inUse) --slotsOfType_[(int)s.type()];
+        emit(LotEventKind::SlotClosed, s.type(), idx, s.occupied() ? s.getTicket().vehicleID : "");
+        return LotStatus::OK;
+    }
+
+    // Close [first, last] (e.g. a row), returns how many slots were closed
+    int decommissionRange(int first, int last) {
+        int closed = 0;
+        for (int i = max(first, 0); i <= last && i < (int)slots_.size(); ++i)
+            if (decommissionSlot(i) == LotStatus::OK) ++closed;
+        return closed;
+    }
+
+    // Put a closed (or draining) slot back in service
+    LotStatus reopenSlot(int idx) {
+        if (idx < 0 || idx >= (int)slots_.size() || !slots_[idx].closed()) return LotStatus::INVALID;
+        Slot &s = slots_.mut(idx);
+        bool inUse = s.occupied() || heldSlots_.count(idx);
+        s.setClosed(false);
+        if (!inUse) {
+            ++slotsOfType_[(int)s.type()];
+            freeSlot(idx);
+        }
+        emit(LotEventKind::SlotOpened, s.type(), idx, "");
+        if (!inUse) serveWaitlist();
+        return LotStatus::OK;
+    }
+
+    // Convert a free or closed slot to slot type st (occupied slots must drain first)
+    LotStatus retypeSlot(int idx, VehicleType st) {
+        if (idx < 0 || idx >= (int)slots_.size() || !ownsSlots(st)) return LotStatus::INVALID;
+        Slot &s = slots_.mut(idx);
+        if (s.occupied() || heldSlots_.count(idx)) return LotStatus::DUPLICATE;
+        if (s.type() == st) return LotStatus::OK;
+        bool open = !s.closed();
+        if (open) {
+            withdrawSlot(idx);
+            --slotsOfType_[(int)s.type()];
+        }
+        s.setType(st);
+        if (hasMultiBayUsers((int)st)) runIndex_[(int)st].cover(idx);
+        if (open) {
+            ++slotsOfType_[(int)st];
+            freeSlot(idx);
+        }
+        emit(LotEventKind::SlotRetyped, st, idx, "");
+        if (open) serveWaitlist();
+        return LotStatus::OK;
+    }
+
+    // Replace the minute clock (reservations and anything time-based use it)
+    void setClock(function<long long()> clock) { clock_ = move(clock); }
+    long long now() const { return clock_(); }
+
+    // Book a slot type for [start, end) minutes. Returns the reservation id,
+    // or -1 if the window is invalid or capacity is exhausted in any part of it.
+    long long reserve(const string& customer, VehicleType vt, long long start, long long end) {
+        PL_TIME_OP(LotOp::Reserve);
+        processReservations();
+        int st = (int)slotTypeFor(vt);
+        CapacityTimeline &tl = bookings_[st];
+        long long nowT = clock_();
+        if (baysFor(vt) > 1 || end <= start || end <= nowT) {
+            if (verbose_) cout << "❗ Invalid reservation request.\n";
+            return -1;
+        }
+        // Slide the horizon forward once it is half used; only live bookings are re-added
+        if (end > tl.horizonEnd() && nowT - tl.origin() > (long long)CapacityTimeline::kBuckets * CapacityTimeline::kBucketMinutes / 2) {
+            tl.reset(nowT);
+            for (const auto &kv : reservations_)
+                if ((int)kv.second.slotType == st)
+                    tl.book(max(kv.second.start, tl.origin()), kv.second.end, +1);
+        }
+        int b1, b2;
+        if (!tl.bucketRange(max(start, tl.origin()), end, b1, b2)) {
+            if (verbose_) cout << "❗ Reservation window is outside the booking horizon.\n";
+            return -1;
+        }
+        if (tl.maxBooked(max(start, tl.origin()), end) >= slotCount(st)) {
+            if (verbose_) cout << "⏳ No " << vehicleTypeToStr(vt) << " capacity for that window.\n";
+            return -1;
+        }
+        Reservation r;
+        r.id = ++reservationCounter_;
+        r.customer = customer;
+        r.vtype = vt;
+        r.slotType = (VehicleType)st;
+        r.start = max(start, tl.origin());
+        r.end = end;
+        tl.book(r.start, r.end, +1);
+        activations_.emplace(r.start, r.id);
+        expiries_.emplace(r.end, r.id);
+        reservations_[r.id] = r;
+        processReservations();
+        if (verbose_) {
+            cout << "📅 Reservation R" << r.id << " | " << customer << " | " << vehicleTypeToStr(r.vtype)
+                 << " | minutes " << r.start << " - " << r.end << "\n";
+        }
+        return r.id;
+    }
+
+    // Cancel a booking or hold; its capacity is returned immediately
+    bool cancelReservation(long long id) {
+        PL_TIME_OP(LotOp::Cancel);
+        processReservations();
+        auto it = reservations_.find(id);
+        if (it == reservations_.end() || it->second.state == Reservation::CLAIMED) {
+            if (verbose_) cout << "❗ Reservation R" << id << " not found or already used.\n";
+            return false;
+        }
+        Reservation &r = it->second;
+        if (r.state == Reservation::HELD) releaseHold(r);
+        bookings_[(int)r.slotType].book(r.start, r.end, -1);
+        reservations_.erase(it);
+        processReservations();   // a released hold may serve a pending one
+        if (verbose_) cout << "✅ Reservation R" << id << " cancelled.\n";
+        return true;
+    }
+
+    // Customer arrives: turn the held slot into a ticket for vehicleID
+    bool claimReservation(long long id, const string& vehicleID) {
+        PL_TIME_OP(LotOp::Claim);
+        processReservations();
+        auto it = reservations_.find(id);
+        if (it == reservations_.end() || it->second.state != Reservation::HELD) {
+            if (verbose_) cout << "❗ Reservation R" << id << " has no slot held right now.\n";
+            return false;
+        }
+        PL_COUNT(LotCounter::MapProbes, 1);
+        if (vehicleToSlot_.count(vehicleID)) {
+            if (verbose_) cout << "❗ Vehicle \"" << vehicleID << "\" already parked.\n";
+            return false;
+        }
+        Reservation &r = it->second;
+        int slotIdx = r.slotIndex;
+        heldSlots_.erase(slotIdx);
+        r.state = Reservation::CLAIMED;
+        r.slotIndex = -1;
+        string tid = nextTicketID();
+        Ticket t(tid, vehicleID, r.vtype, slotIdx);
+        occupy(t);
+        mapVehicle(vehicleID, slotIdx);
+        totalVehiclesServed_++;
+        emit(LotEventKind::SlotAssigned, r.vtype, slotIdx, vehicleID);
+        if (verbose_) {
+            cout << "\n🎫 Ticket: " << tid << "  | Vehicle: " << vehicleID << " | Reservation: R" << id
+                 << " | Slot#: " << (slotIdx + 1) << "\n";
+        }
+        return true;
+    }
+
+    // List live reservations
+    void displayReservations() {
+        processReservations();
+        vector<const Reservation*> list;
+        for (const auto &kv : reservations_) list.push_back(&kv.second);
+        sort(list.begin(), list.end(), [](const Reservation* a, const Reservation* b) { return a->id < b->id; });
+        cout << "\n📅 Reservations (now = minute " << clock_() << "): " << list.size() << "\n";
+        for (const Reservation* r : list) {
+            cout << "  R" << r->id << " | " << r->customer << " | " << vehicleTypeToStr(r->vtype)
+                 << " | " << r->start << " - " << r->end << " | " << reservationStateToStr(r->state);
+            if (r->state == Reservation::HELD) cout << " | Slot#: " << (r->slotIndex + 1);
+            cout << "\n";
+        }
+    }
+
+    // Projected occupancy per slot type for the next 'hours' hours
+    void displayForecast(int hours) {
+        processReservations();
+        long long nowT = clock_();
+        cout << "\n🔮 Occupancy forecast (next " << hours << " hour(s))\n";
+        for (int t = 0; t < vehicleClassCount(); ++t) {
+            int cap = slotsOfType_[t];
+            if (cap == 0) continue;
+            int occ = cap - (int)freePools_[t]->size();
+            vector<int> proj = forecaster_->forecast(nowT, (VehicleType)t, occ, cap, hours);
+            cout << "  " << left << setw(6) << vehicleTypeToStr((VehicleType)t) << right << " now " << occ << "/" << cap << " |";
+            int fullAt = -1;
+            for (int h = 0; h < (int)proj.size(); ++h) {
+                cout << " +" << (h + 1) << "h:" << proj[h];
+                if (fullAt < 0 && proj[h] >= cap) fullAt = h + 1;
+            }
+            if (fullAt > 0) cout << " | full within ~" << fullAt << "h";
+            cout << "\n";
+        }
+    }
+
+    // Hot-path instrumentation (latency histograms, counters, trace ring)
+    Instrumentation& instrumentation() { return instr_; }
+    const Instrumentation& instrumentation() const { return instr_; }
+
+    // One-shot notification when vehicleID is promoted from the waitlist.
+    // Replaces any earlier subscription for the same vehicle.
+    void subscribePromotion(const string& vehicleID, PromotionCallback callback) {
+        promotionSubs_[vehicleID] = PromotionSubscription{move(callback), -1};
+    }
+    // Same, signalled through an eventfd (value added = slot index + 1)
+    void subscribePromotionFd(const string& vehicleID, int eventFd) {
+        promotionSubs_[vehicleID] = PromotionSubscription{nullptr, eventFd};
+    }
+    bool unsubscribePromotion(const string& vehicleID) {
+        auto it = find_if(waitlist_.begin(), waitlist_.end(), [&](const WaitEntry& w) { return w.vehicleID == vehicleID; });
+        if (!cancelSubscription(vehicleID, it == waitlist_.end() ? VehicleType::CAR : it->type)) return false;
+        if (!deferNotices_) dispatchNotifications();
+        return true;
+    }
+
+    // When the lot is used behind an external lock, defer dispatch and call
+    // dispatchNotifications() after unlocking. Otherwise notices go out at
+    // the end of the vehicleExit that produced them.
+    void setDeferredNotifications(bool defer) { deferNotices_ = defer; }
+
+    size_t dispatchNotifications() {
+        vector<pair<PromotionSubscription, PromotionNotice>> batch;
+        batch.swap(pendingNotices_);       // callbacks may re-enter the lot
+        for (auto &item : batch) {
+            PromotionSubscription &sub = item.first;
+            if (sub.callback) sub.callback(item.second);
+            if (sub.eventFd >= 0 && item.second.slotIndex >= 0) {
+                uint64_t v = (uint64_t)item.second.slotIndex + 1;
+                if (write(sub.eventFd, &v, sizeof(v)) < 0) { /* reader gone; nothing to do */ }
+            }
+        }
+        return batch.size();
+    }
+
+    // Lock-free gauges for scrapers on other threads
+    const LotMetrics& metrics() const { return metrics_; }
+
+    // Suppress per-operation console output (benchmarks, batch drivers)
+    void setVerbose(bool v) { verbose_ = v; }
+
+    // Partial-plate search index; turning it on indexes every parked plate
+    void setPlateSearch(bool on) {
+        plateSearch_ = on;
+        plateIndex_.clear();
+        if (!on) return;
+        vector<string> plates;
+        plates.reserve(vehicleToSlot_.size());
+        vehicleToSlot_.forEach([&](const string& id, int) { plates.push_back(id); });
+        plateIndex_.build(plates);
+    }
+    bool plateSearch() const { return plateSearch_; }
+
+    /* Misread plates at exit: with maxDistance > 0, an exit whose ID is not
+       parked looks for parked plates within maxDistance by OCR-weighted
+       edit distance (0.25 per O/0-style confusion, 1 per other edit). It
+       releases one only when that plate is within maxDistance, differs
+       from the read only by confusions, and no other parked plate does at
+       any distance (PLATE_CORRECTED, plate set); otherwise it releases
+       nothing and returns the candidates, every such twin included
+       (AMBIGUOUS_PLATE). 0 = exact IDs only (default); exits that match
+       exactly never consult it. */
+    void setExitPlateMatching(double maxDistance) {
+        exitMatchDistance_ = max(0.0, maxDistance);
+        plateMatcher_.clear();
+        if (exitMatchDistance_ == 0) return;
+        vector<string> plates;
+        plates.reserve(vehicleToSlot_.size());
+        vehicleToSlot_.forEach([&](const string& id, int) { plates.push_back(id); });
+        plateMatcher_.build(plates);
+    }
+    double exitPlateMatching() const { return exitMatchDistance_; }
+
+    // Parked plates within maxDistance of a plate as read, nearest first;
+    // scans the vehicle map when exit matching is off
+    vector<PlateMatcher::Candidate> matchPlates(const string& read, double maxDistance, size_t limit = 5) const {
+        if (exitMatchDistance_ > 0) return plateMatcher_.match(read, maxDistance, limit);
+        vector<PlateMatcher::Candidate> out;
+        vehicleToSlot_.forEach([&](const string& id, int) {
+            double d = PlateMatcher::ocrDistance(read, id);
+            if (d <= maxDistance) out.push_back(PlateMatcher::Candidate{id, d});
+        });
+        sort(out.begin(), out.end(), [](const PlateMatcher::Candidate& a, const PlateMatcher::Candidate& b) {
+            return a.distance != b.distance ? a.distance < b.distance : a.plate < b.plate;
+        });
+        if (out.size() > limit) out.resize(limit);
+        return out;
+    }
+
+    /* Parked vehicles whose plate starts with (prefixOnly) or contains
+       fragment, as (plate, slot index), up to limit; prefix matches first.
+       Uses the plate index when it is on, else scans the vehicle map. */
+    vector<pair<string, int>> findPlates(const string& fragment, bool prefixOnly = false, size_t limit = 20) const {
+        vector<pair<string, int>> found;
+        if (plateSearch_) {
+            for (auto &plate : plateIndex_.search(fragment, prefixOnly, limit)) {
+                int slot = vehicleToSlot_.slotOf(plate);
+                found.emplace_back(move(plate), slot);
+            }
+            return found;
+        }
+        if (fragment.empty()) return found;
+        vector<pair<string, int>> inside;
+        vehicleToSlot_.forEach([&](const string& id, int slot) {
+            size_t at = id.find(fragment);
+            if (at == 0) found.emplace_back(id, slot);
+            else if (at != string::npos && !prefixOnly) inside.emplace_back(id, slot);
+        });
+        sort(found.begin(), found.end());
+        sort(inside.begin(), inside.end());
+        found.insert(found.end(), inside.begin(), inside.end());
+        if (found.size() > limit) found.resize(limit);
+        return found;
+    }
+
+    // Update hourly rate (parameter renamed to 'rate' for clarity)
+    void setRate(VehicleType vt, double rate) {
+        ratePerHour_[(int)vt] = rate;
+        emit(LotEventKind::RateChanged, vt, -1, "", rate);
+    }
+
+    // Subscribe to the change feed. fromStart=false delivers only events
+    // published after this call; true starts at the oldest retained event.
+    EventSubscriber subscribe(bool fromStart = false) const {
+        uint64_t last = events_.lastSeq();
+        if (!fromStart) return EventSubscriber(events_, last + 1);
+        return EventSubscriber(events_, last >= events_.capacity() ? last - events_.capacity() + 1 : 1);
+    }
+
+    // Entry: allocate a free slot per the lot's strategy; if none, add to waitlist
+    LotResult vehicleEntry(const string& vehicleID, VehicleType vt) {
+        PL_TIME_OP(LotOp::Entry);
+        processReservations();
+        PL_COUNT(LotCounter::MapProbes, 1);
+        int found = vehicleToSlot_.slotOf(vehicleID);
+        if (found >= 0) {
+            if (verbose_) cout << "❗ Vehicle \"" << vehicleID << "\" already parked in slot " << (found + 1) << "\n";
+            return LotResult{LotStatus::DUPLICATE, found, 0.0, 0};
+        }
+        if (!waitlisted_.empty() && waitlisted_.count(vehicleID)) {
+            LotResult q = queryVehicle(vehicleID);
+            if (verbose_) cout << "❗ Vehicle \"" << vehicleID << "\" is already waitlisted at position " << q.waitPosition << "\n";
+            return LotResult{LotStatus::DUPLICATE, -1, 0.0, q.waitPosition};
+        }
+        int slotIdx = allocateFor(vt);
+        if (slotIdx >= 0) {
+            string tid = nextTicketID();
+            Ticket t(tid, vehicleID, vt, slotIdx);
+            occupy(t);
+            mapVehicle(vehicleID, slotIdx);
+            totalVehiclesServed_++;
+            emit(LotEventKind::SlotAssigned, vt, slotIdx, vehicleID);
+            if (verbose_) {
+                cout << "\n🎫 Ticket: " << tid << "  | Vehicle: " << vehicleID
+                     << " | Type: " << vehicleTypeToStr(vt) << " | Slot#: " << (slotIdx + 1);
+                if (t.bays > 1) cout << "-" << (slotIdx + t.bays);
+                if (slots_[slotIdx].type() != slotTypeFor(vt)) cout << " (" << vehicleTypeToStr(slots_[slotIdx].type()) << " slot)";
+                cout << "\n";
+            }
+            return LotResult{LotStatus::OK, slotIdx, 0.0, 0};
+        } else {
+            waitlist_.emplace_back(vehicleID, vt, clock_());
+            waitlisted_.insert(vehicleID);
+            emit(LotEventKind::Waitlisted, vt, -1, vehicleID);
+            if (verbose_) {
+                cout << "\n⏳ No free " << vehicleTypeToStr(vt) << " slots. Added to waitlist position " << waitlist_.size() << "\n";
+            }
+            return LotResult{LotStatus::WAITLISTED, -1, 0.0, waitlist_.size()};
+        }
+    }
+
+    // Entry through a gate of the garage layout: the nearest free slot to that
+    // gate is taken instead of the strategy's pick
+    LotResult vehicleEntryAt(const string& vehicleID, VehicleType vt, int gate) {
+        if (topology_ && gate >= 0 && gate < (int)topology_->gates().size()) entryGate_ = gate;
+        LotResult r = vehicleEntry(vehicleID, vt);
+        entryGate_ = -1;
+        return r;
+    }
+
+    // Exit: user supplies duration in minutes; calculate fee; free slot; serve waitlist if applicable
+    LotResult vehicleExit(const string& vehicleID, long long durationMinutes) {
+        PL_TIME_OP(LotOp::Exit);
+        processReservations();
+        ParkedHandle h = findParked(vehicleID);
+        if (!h) {
+            if (exitMatchDistance_ > 0) return exitMisread(vehicleID, durationMinutes);
+            if (verbose_) cout << "❗ Vehicle \"" << vehicleID << "\" not found.\n";
+            return LotResult{LotStatus::NOT_FOUND, -1, 0.0, 0};
+        }
+        return releaseParked(h, vehicleID, durationMinutes);
+    }
+
+private:
+    // Cold path of vehicleExit for an ID that is not parked: release the
+    // only parked plate it is a pure OCR misread of, else report candidates
+    LotResult exitMisread(const string& read, long long durationMinutes) {
+        const size_t kCandidates = 5;
+        // Uniqueness comes from the key's node, not the candidate list: a
+        // twin with more confusions than maxDistance allows must still block
+        vector<string> twins = plateMatcher_.sameKey(read);
+        if (twins.size() == 1 && PlateMatcher::ocrDistance(read, twins[0]) <= exitMatchDistance_) {
+            string plate = twins[0];
+            if (verbose_) cout << "🔁 No exact match for \"" << read << "\"; exiting \"" << plate << "\" (OCR confusions only).\n";
+            LotResult r = releaseParked(findParked(plate), plate, durationMinutes);
+            if (r.status == LotStatus::OK) r.status = LotStatus::PLATE_CORRECTED;
+            r.plate = plate;
+            return r;
+        }
+        vector<PlateMatcher::Candidate> c = plateMatcher_.match(read, exitMatchDistance_, kCandidates);
+        for (const auto &p : twins) {
+            if (find_if(c.begin(), c.end(), [&](const PlateMatcher::Candidate& m) { return m.plate == p; }) == c.end())
+                c.push_back(PlateMatcher::Candidate{p, PlateMatcher::ocrDistance(read, p)});
+        }
+        sort(c.begin(), c.end(), [](const PlateMatcher::Candidate& a, const PlateMatcher::Candidate& b) {
+            return a.distance != b.distance ? a.distance < b.distance : a.plate < b.plate;
+        });
+        if (c.empty()) {
+            if (verbose_) cout << "❗ Vehicle \"" << read << "\" not found.\n";
+            return LotResult{LotStatus::NOT_FOUND, -1, 0.0, 0};
+        }
+        if (verbose_) {
+            cout << "❓ \"" << read << "\" is not parked; nearest plates:";
+            for (const auto &m : c) cout << " " << m.plate << " (" << m.distance << ")";
+            cout << "\n";
+        }
+        LotResult r{LotStatus::AMBIGUOUS_PLATE, -1, 0.0, 0};
+        r.plate = c[0].plate;
+        r.candidates = move(c);
+        return r;
+    }
+
+    // Bill and release a parked vehicle found by findParked(vehicleID)
+    LotResult releaseParked(ParkedHandle h, const string& vehicleID, long long durationMinutes) {
+        const Slot &s = slots_[h.slotIndex];
+        PL_INVARIANT(s.occupied() && s.getTicket().vehicleID == vehicleID, "vehicle map entry must address its own occupied slot");
+        if (!s.occupied() || s.getTicket().vehicleID != vehicleID) {
+            // Checks compiled out: report the drift and drop the stale entry rather than bill a wrong slot
+            cerr << "⚠️ Internal inconsistency: \"" << vehicleID << "\" maps to slot " << (h.slotIndex + 1)
+                 << (s.occupied() ? ", held by \"" + s.getTicket().vehicleID + "\"" : string(", which is free")) << "; entry dropped.\n";
+            unmapStale(h, vehicleID);
+            return LotResult{LotStatus::NOT_FOUND, -1, 0.0, 0};
+        }
+
+        // Billed at the vehicle's own rate, even when parked in a larger slot
+        shared_ptr<const Ticket> t = s.ticketRef();
+        VehicleType billedType = t->vtype;
+        VehicleType slotType = s.type();
+        long long minutes = max(0LL, durationMinutes);
+        long long hours = billedHours(minutes);
+        double rate = ratePerHour_[(int)billedType];
+        double fee = hours * rate;
+
+        for (int i = h.slotIndex; i < h.slotIndex + t->bays; ++i) slots_.mut(i).vacate();
+        digest_.unpark(h.slotIndex, vehicleID);
+        digest_.toggleMap(h.slotIndex, vehicleID);
+        vehicleToSlot_.eraseAt(h.entry);
+        if (plateSearch_) plateIndex_.erase(vehicleID);
+        if (exitMatchDistance_ > 0) plateMatcher_.erase(vehicleID);
+        totalEarnings_ += fee;
+        long long nowT = clock_();
+        forecaster_.mut().record(nowT, slotType, -t->bays);
+        occupiedSlots_ -= t->bays;
+        LotStatistics &st = stats_.mut();
+        st.dwell[(int)billedType].record((uint64_t)minutes);
+        st.fee[(int)billedType].record((uint64_t)llround(fee * 100));
+        st.exits++;
+        st.trackedUntil = max(st.trackedUntil, nowT);
+        emit(LotEventKind::SlotReleased, billedType, h.slotIndex, vehicleID, fee);
+        if (verbose_) printReceipt(vehicleID, *t, slotType, minutes, hours, rate, fee);
+
+        releaseAndPromote(h.slotIndex, t->bays);
+        publishMetrics();   // the SlotReleased event went out before the bays were pooled
+        if (!deferNotices_) dispatchNotifications();
+        return LotResult{LotStatus::OK, h.slotIndex, fee, 0};
+    }
+
+public:
+    /* Full consistency check, O(slots + vehicles + waitlist):
+        - every map entry addresses an occupied slot holding that vehicle,
+          and every occupied slot's vehicle maps back to its ticket
+        - a slot is in a free pool (and free in its run index) exactly when
+          it is free, open and not held; pool sizes match
+        - occupied and in-service counters match the slots
+        - no waitlisted vehicle is also parked
+       Read-only; call it on the thread that owns the lot or under the
+       lot's lock (see LotAuditor). */
+    // Check one slot against the vehicle map, the free pools and the run
+    // index, folding it into recomputed checksums; true if it is rightly
+    // in its own free pool
+    bool auditSlot(const Slot& s, AuditReport& r, uint64_t& freeSum, uint64_t& parkedSum) const {
+        int idx = s.index(), st = (int)s.type();
+        bool held = !heldSlots_.empty() && heldSlots_.count(idx);
+        bool shouldBeFree = !s.occupied() && !s.closed() && !held;
+        bool pooled = false;
+        if (s.occupied()) {
+            const Ticket &t = s.getTicket();
+            if (t.slotIndex == idx) parkedSum ^= LotDigest::parkedKey(idx, t.vehicleID);
+            int mapped = vehicleToSlot_.slotOf(t.vehicleID);
+            if (mapped < 0)
+                r.fail("slot " + to_string(idx + 1) + " holds " + t.vehicleID + " but the vehicle map has no entry");
+            else if (mapped != t.slotIndex || idx < t.slotIndex || idx >= t.slotIndex + t.bays)
+                r.fail("slot " + to_string(idx + 1) + " holds " + t.vehicleID + " but the map says slot " + to_string(mapped + 1));
+        }
+        for (int p = 0; p < vehicleClassCount(); ++p) {
+            if (!freePools_[p]->contains(idx)) continue;
+            freeSum ^= LotDigest::freeKey(idx);
+            if (p != st) r.fail("slot " + to_string(idx + 1) + " sits in the " + vehicleTypeToStr((VehicleType)p) + " pool but is " + vehicleTypeToStr(s.type()));
+            else if (!shouldBeFree) r.fail("slot " + to_string(idx + 1) + " is in its free pool but is " + (s.occupied() ? "occupied by " + s.getTicket().vehicleID : held ? "held" : "closed"));
+            else pooled = true;
+        }
+        if (shouldBeFree && !pooled) r.fail("free slot " + to_string(idx + 1) + " is missing from its pool");
+        if (runIndex_[st].active() && runIndex_[st].isFree(idx) != shouldBeFree)
+            r.fail("run index disagrees about slot " + to_string(idx + 1));
+        return pooled;
+    }
+
+    AuditReport audit() const {
+        AuditReport r;
+        size_t freeOf[kMaxVehicleClasses] = {0};
+        int inService[kMaxVehicleClasses] = {0};
+        long long occupied = 0;
+        uint64_t freeSum = 0, parkedSum = 0;
+        for (const auto &s : slots_) {
+            ++r.checked;
+            int st = (int)s.type();
+            bool held = !heldSlots_.empty() && heldSlots_.count(s.index());
+            if (!s.closed() || s.occupied() || held) ++inService[st];
+            if (s.occupied()) ++occupied;
+            if (auditSlot(s, r, freeSum, parkedSum)) ++freeOf[st];
+        }
+        vehicleToSlot_.forEach([&](const string& id, int slot) {
+            ++r.checked;
+            if (slot >= (int)slots_.size() || !slots_[slot].occupied() || slots_[slot].getTicket().vehicleID != id)
+                r.fail("map entry " + id + " -> slot " + to_string(slot + 1) + " does not match the slot");
+        });
+        for (int t = 0; t < vehicleClassCount(); ++t) {
+            if (freePools_[t]->size() != freeOf[t])
+                r.fail(vehicleTypeToStr((VehicleType)t) + " pool size " + to_string(freePools_[t]->size()) + " != " + to_string(freeOf[t]) + " free slots");
+            if (slotsOfType_[t] != inService[t])
+                r.fail(vehicleTypeToStr((VehicleType)t) + " in-service count " + to_string(slotsOfType_[t]) + " != " + to_string(inService[t]));
+        }
+        if (occupied != occupiedSlots_)
+            r.fail("occupied counter " + to_string(occupiedSlots_) + " != " + to_string(occupied) + " occupied slots");
+        for (const auto &w : waitlist_) {
+            ++r.checked;
+            if (vehicleToSlot_.count(w.vehicleID)) r.fail(w.vehicleID + " is both waitlisted and parked");
+            if (!waitlisted_.count(w.vehicleID)) r.fail(w.vehicleID + " is waitlisted but missing from the waitlist index");
+        }
+        if (waitlisted_.size() != waitlist_.size())
+            r.fail("waitlist index holds " + to_string(waitlisted_.size()) + " IDs for " + to_string(waitlist_.size()) + " entries");
+        uint64_t keptFree = 0, keptParked = 0;
+        for (size_t c = 0; c < digest_.chunks(); ++c) { keptFree ^= digest_.freeSum(c); keptParked ^= digest_.parkedSum(c); }
+        if (keptFree != freeSum || keptParked != parkedSum) r.fail("incremental checksums differ from a full recount");
+        checkLotDigest(r);
+        return r;
+    }
+
+    // O(1) whole-lot checks: map checksum vs parked checksum, and map size vs
+    // parked vehicles. With every parked head probing its own map entry
+    // (auditSlot), equal sizes leave no room for stale map entries.
+    void checkLotDigest(AuditReport& r) const {
+        if (digest_.parkedTotal() != digest_.mapTotal()) r.fail("vehicle map checksum differs from the parked-slot checksum");
+        if (digest_.vehicles() != vehicleToSlot_.size())
+            r.fail("vehicle map holds " + to_string(vehicleToSlot_.size()) + " entries for " + to_string(digest_.vehicles()) + " parked vehicles");
+        if (plateSearch_ && plateIndex_.size() != vehicleToSlot_.size())
+            r.fail("plate index holds " + to_string(plateIndex_.size()) + " plates for " + to_string(vehicleToSlot_.size()) + " parked vehicles");
+        if (exitMatchDistance_ > 0 && plateMatcher_.size() != vehicleToSlot_.size())
+            r.fail("plate matcher holds " + to_string(plateMatcher_.size()) + " plates for " + to_string(vehicleToSlot_.size()) + " parked vehicles");
+    }
+
+    // Chunks of LotDigest::kChunk slots covered by auditChunk()
+    size_t auditChunkCount() const { return (slots_.size() + LotDigest::kChunk - 1) / LotDigest::kChunk; }
+
+    /* Verify one chunk of slots, O(kChunk): each slot against the map,
+       pools and run index, the chunk's recomputed checksums against the
+       incremental ones, and the O(1) map-vs-parked checksum for the whole
+       lot. Cheap enough to run under the lot's lock between gate batches. */
+    AuditReport auditChunk(size_t chunk) const {
+        AuditReport r;
+        size_t lo = chunk * LotDigest::kChunk, hi = min(slots_.size(), lo + LotDigest::kChunk);
+        uint64_t freeSum = 0, parkedSum = 0;
+        for (size_t i = lo; i < hi; ++i) {
+            ++r.checked;
+            auditSlot(slots_[i], r, freeSum, parkedSum);
+        }
+        string range = " (slots " + to_string(lo + 1) + "-" + to_string(hi) + ")";
+        if (freeSum != digest_.freeSum(chunk)) r.fail("free-index checksum mismatch in chunk " + to_string(chunk) + range);
+        if (parkedSum != digest_.parkedSum(chunk)) r.fail("parked-slot checksum mismatch in chunk " + to_string(chunk) + range);
+        checkLotDigest(r);
+        return r;
+    }
+
+    // Diagnostic dump for a failed chunk: checksums kept vs recounted, the
+    // state of every slot in the chunk that fails a check, map entries that
+    // point into the chunk but disagree with it, and the problems found
+    void dumpDiagnostics(ostream& out, size_t chunk) const {
+        size_t lo = chunk * LotDigest::kChunk, hi = min(slots_.size(), lo + LotDigest::kChunk);
+        AuditReport r = auditChunk(chunk);
+        uint64_t freeSum = 0, parkedSum = 0;
+        vector<int> bad;
+        for (size_t i = lo; i < hi; ++i) {
+            AuditReport one;
+            auditSlot(slots_[i], one, freeSum, parkedSum);
+            if (!one.ok()) bad.push_back((int)i);
+        }
+        out << hex << setfill('0')
+            << "chunk " << dec << chunk << " slots " << (lo + 1) << "-" << hi << " of " << slots_.size() << "\n" << hex
+            << "free checksum   kept " << setw(16) << digest_.freeSum(chunk) << " recount " << setw(16) << freeSum << "\n"
+            << "parked checksum kept " << setw(16) << digest_.parkedSum(chunk) << " recount " << setw(16) << parkedSum << "\n"
+            << "lot checksums   parked " << setw(16) << digest_.parkedTotal() << " map " << setw(16) << digest_.mapTotal() << "\n"
+            << dec << setfill(' ');
+        out << "vehicles " << vehicleToSlot_.size() << ", waitlist " << waitlist_.size() << ", occupied " << occupiedSlots_ << "\n";
+        out << "slot\ttype\tstate\tpools\tvehicle\tmap\n";
+        for (int i : bad) {
+            const Slot &sl = slots_[i];
+            bool held = heldSlots_.count(i) > 0;
+            string pools;
+            for (int p = 0; p < vehicleClassCount(); ++p)
+                if (freePools_[p]->contains(i)) pools += (pools.empty() ? "" : ",") + vehicleTypeToStr((VehicleType)p);
+            out << (i + 1) << "\t" << vehicleTypeToStr(sl.type()) << "\t"
+                << (sl.occupied() ? "OCC" : held ? "HELD" : sl.closed() ? "CLOSED" : "FREE") << (sl.occupied() && sl.closed() ? "+CLOSED" : "")
+                << "\t" << (pools.empty() ? "-" : pools) << "\t";
+            if (sl.occupied()) {
+                const Ticket &t = sl.getTicket();
+                int mapped = vehicleToSlot_.slotOf(t.vehicleID);
+                out << t.vehicleID << "\t" << (mapped < 0 ? string("missing") : to_string(mapped + 1));
+            } else {
+                out << "-\t-";
+            }
+            out << "\n";
+        }
+        vehicleToSlot_.forEach([&](const string& id, int slot) {
+            if (slot < (int)lo || slot >= (int)hi) return;
+            const Slot &sl = slots_[slot];
+            if (!sl.occupied() || sl.getTicket().vehicleID != id)
+                out << "map " << id << " -> slot " << (slot + 1) << " but the slot holds "
+                    << (sl.occupied() ? sl.getTicket().vehicleID : string("nothing")) << "\n";
+        });
+        out << "problems (" << r.violations << "):\n";
+        for (const auto &p : r.problems) out << "  " << p << "\n";
+    }
+
+    // A waitlisted vehicle gives up; vehicles it was blocking are then served.
+    // O(waitlist). False if the vehicle is not waitlisted.
+    bool leaveWaitlist(const string& vehicleID) {
+        if (!waitlisted_.count(vehicleID)) return false;
+        auto it = find_if(waitlist_.begin(), waitlist_.end(), [&](const WaitEntry& w) { return w.vehicleID == vehicleID; });
+        bool wasFront = it == waitlist_.begin();
+        VehicleType vt = it->type;
+        waitlist_.erase(it);
+        waitlisted_.erase(vehicleID);
+        cancelSubscription(vehicleID, vt);
+        emit(LotEventKind::WaitlistLeft, vt, -1, vehicleID);
+        if (wasFront) serveWaitlist();
+        if (!deferNotices_) dispatchNotifications();
+        return true;
+    }
+
+    // Call f(ticket) once per parked vehicle, in slot order
+    template <typename F>
+    void forEachParked(F f) const {
+        for (const auto &s : slots_)
+            if (s.occupied() && s.getTicket().slotIndex == s.index()) f(s.getTicket());
+    }
+
+    // Call f(entry) for each waitlisted vehicle, front first
+    template <typename F>
+    void forEachWaiting(F f) const { for (const auto &w : waitlist_) f(w); }
+
+    // Close 'count' in-service slots of slot type st, highest index first
+    // (occupied ones drain). Returns how many were closed.
+    int closeSlots(VehicleType st, int count) {
+        int closed = 0;
+        for (int i = (int)slots_.size() - 1; i >= 0 && closed < count; --i)
+            if (slots_[i].type() == st && decommissionSlot(i) == LotStatus::OK) ++closed;
+        return closed;
+    }
+
+    // Where is a vehicle: parked slot, waitlist position, or NOT_FOUND
+    LotResult queryVehicle(const string& vehicleID) const {
+        int slot = vehicleToSlot_.slotOf(vehicleID);
+        if (slot >= 0) return LotResult{LotStatus::OK, slot, 0.0, 0};
+        size_t pos = 1;
+        for (const auto &w : waitlist_) {
+            if (w.vehicleID == vehicleID) return LotResult{LotStatus::WAITLISTED, -1, 0.0, pos};
+            ++pos;
+        }
+        return LotResult{LotStatus::NOT_FOUND, -1, 0.0, 0};
+    }
+
+    // Show availability & waitlist
+    void displayAvailability(ostream& out = cout) const {
+        size_t freeTotal = 0;
+        for (int t = 0; t < vehicleClassCount(); ++t) freeTotal += freePools_[t]->size();
+        out << "\n📊 Availability: Free total = " << freeTotal << "  (";
+        bool first = true;
+        for (int t = 0; t < vehicleClassCount(); ++t) {
+            if (!ownsSlots((VehicleType)t)) continue;
+            out << (first ? "" : ", ") << vehicleTypeToStr((VehicleType)t) << ": " << freePools_[t]->size();
+            first = false;
+        }
+        out << ")\n";
+        for (int t = 0; t < vehicleClassCount(); ++t) {
+            if (runIndex_[t].active())
+                out << "   Longest free " << vehicleTypeToStr((VehicleType)t) << " run: " << runIndex_[t].longestRun() << " slot(s)\n";
+        }
+
+        out << "\n🚗 Occupied slots:\n";
+        bool any = false;
+        for (const auto &s : slots_) {
+            if (s.occupied()) {
+                any = true;
+                const Ticket &tk = s.getTicket();
+                out << "  Slot " << (s.index()+1) << " | " << vehicleTypeToStr(s.type())
+                     << " | Vehicle: " << tk.vehicleID << " | Ticket: " << tk.id << "\n";
+            }
+        }
+        if (!any) out << "  (none)\n";
+
+        out << "\n📋 Waitlist size: " << waitlist_.size() << "\n";
+        if (!waitlist_.empty()) {
+            out << " Front -> Back:\n";
+            int pos = 1;
+            for (const auto &w : waitlist_) {
+                out << "  " << pos++ << ". " << w.vehicleID << " (" << vehicleTypeToStr(w.type) << ")\n";
+            }
+        }
+    }
+
+    // Show stats
+    void displayStats(ostream& out = cout) const {
+        int occupied = (int)occupiedSlots_;
+        int total = 0;   // in service (closed slots excluded once drained)
+        for (int t = 0; t < vehicleClassCount(); ++t) total += slotsOfType_[t];
+        double occupancy = total == 0 ? 0.0 : (100.0 * occupied / total);
+        out << fixed << setprecision(2);
+        out << "\n=== Parking Statistics ===\n";
+        out << "Total slots           : " << total << "\n";
+        out << "Currently occupied    : " << occupied << "\n";
+        out << "Occupancy percent     : " << occupancy << "%\n";
+        out << "Total served (history): " << totalVehiclesServed_ << "\n";
+        out << "Total earnings (Rs)   : " << totalEarnings_ << "\n";
+        out << "Rates per hour (Rs)   : ";
+        for (int t = 0; t < vehicleClassCount(); ++t)
+            out << (t ? ", " : "") << vehicleTypeToStr((VehicleType)t) << "=" << ratePerHour_[t];
+        out << "\n";
+        out << "Allocation strategy   : " << strategyToStr(strategy_) << "\n";
+        for (int t = 0; t < vehicleClassCount(); ++t) {
+            if (fallbackType_[t] < 0) continue;
+            out << "Fallback              : " << vehicleTypeToStr((VehicleType)t) << " -> "
+                 << vehicleTypeToStr((VehicleType)fallbackType_[t]) << " slots (reserve " << fallbackReserve_[t] << ")\n";
+        }
+        stats_->display(out);
+    }
+
+    // Distribution sketches, mergeable across lots
+    const LotStatistics& statistics() const { return *stats_; }
+
+    // Combined report for several lots (regional view)
+    static void displayRegionalStats(const vector<const ParkingLot*>& lots) {
+        if (lots.empty()) return;
+        LotStatistics region = lots[0]->statistics();
+        double earnings = 0.0;
+        for (size_t i = 0; i < lots.size(); ++i) {
+            if (i) region.merge(lots[i]->statistics());
+            earnings += lots[i]->totalEarnings_;
+        }
+        cout << fixed << setprecision(2);
+        cout << "\n=== Regional Statistics (" << lots.size() << " lots) ===\n";
+        cout << "Total slots           : " << region.totalSlots << "\n";
+        cout << "Total earnings (Rs)   : " << earnings << "\n";
+        region.display();
+    }
+
+    // Export to CSV: <prefix>_slots.csv, <prefix>_waitlist.csv, <prefix>_stats.csv.
+    // Rows are streamed straight from slots_/waitlist_, nothing is buffered.
+    bool exportCSV(const string& prefix) const {
+        ofstream slotsOut(prefix + "_slots.csv"), waitOut(prefix + "_waitlist.csv"), statsOut(prefix + "_stats.csv");
+        if (!slotsOut || !waitOut || !statsOut) {
+            cout << "❗ Could not open export files for prefix \"" << prefix << "\".\n";
+            return false;
+        }
+        slotsOut << "slot,type,occupied,vehicle,ticket\n";
+        for (const auto &s : slots_) {
+            slotsOut << (s.index() + 1) << ',' << vehicleTypeToStr(s.type()) << ',' << (s.occupied() ? 1 : 0) << ',';
+            if (s.occupied()) slotsOut << csvField(s.getTicket().vehicleID) << ',' << s.getTicket().id;
+            else slotsOut << ',';
+            slotsOut << '\n';
+        }
+        waitOut << "position,vehicle,type\n";
+        int pos = 1;
+        for (const auto &w : waitlist_) {
+            waitOut << pos++ << ',' << csvField(w.vehicleID) << ',' << vehicleTypeToStr(w.type) << '\n';
+        }
+        statsOut << fixed << setprecision(2);
+        statsOut << "metric,value\n"
+                 << "total_slots," << slots_.size() << '\n'
+                 << "total_served," << totalVehiclesServed_ << '\n'
+                 << "total_earnings," << totalEarnings_ << '\n';
+        for (int t = 0; t < vehicleClassCount(); ++t) {
+            string name = vehicleTypeToStr((VehicleType)t);
+            for (char &c : name) c = (char)tolower(c);
+            statsOut << "rate_" << name << ',' << ratePerHour_[t] << '\n';
+        }
+        cout << "✅ CSV export written with prefix \"" << prefix << "\".\n";
+        return true;
+    }
+
+    // Export to the columnar binary layout described at ExportHeader.
+    // One sizing pass computes the blob lengths, then each column is streamed
+    // in its own pass, so memory use does not depend on lot size.
+    bool exportBinary(const string& path) const {
+        ofstream out(path, ios::binary);
+        if (!out) {
+            cout << "❗ Could not open \"" << path << "\" for writing.\n";
+            return false;
+        }
+        uint64_t n = slots_.size(), w = waitlist_.size();
+        uint64_t vehicleBytes = 0, waitBytes = 0;
+        for (const auto &s : slots_) if (s.occupied()) vehicleBytes += s.getTicket().vehicleID.size();
+        for (const auto &e : waitlist_) waitBytes += e.vehicleID.size();
+
+        ExportHeader h{};
+        memcpy(h.magic, "PLEXPRT1", 8);
+        h.version = 4;   // v4: rate table has kMaxVehicleClasses entries, typeCount in use
+        h.headerSize = sizeof(ExportHeader);
+        h.slotCount = n;
+        h.waitCount = w;
+        h.offSlotType = align8(sizeof(ExportHeader));
+        h.offSlotOcc = align8(h.offSlotType + n);
+        h.offTicketNo = align8(h.offSlotOcc + n);
+        h.offVehicleOff = align8(h.offTicketNo + n * sizeof(uint64_t));
+        h.offVehicleBlob = align8(h.offVehicleOff + (n + 1) * sizeof(uint32_t));
+        h.offWaitType = align8(h.offVehicleBlob + vehicleBytes);
+        h.offWaitOff = align8(h.offWaitType + w);
+        h.offWaitBlob = align8(h.offWaitOff + (w + 1) * sizeof(uint32_t));
+        h.offStats = align8(h.offWaitBlob + waitBytes);
+        h.fileSize = h.offStats + sizeof(ExportStats);
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+
+        padTo(out, h.offSlotType);
+        for (const auto &s : slots_) out.put((char)s.type());
+        padTo(out, h.offSlotOcc);
+        for (const auto &s : slots_) out.put(s.occupied() ? 1 : 0);
+        padTo(out, h.offTicketNo);
+        for (const auto &s : slots_) {
+            uint64_t tn = s.occupied() ? ticketNumber(s.getTicket().id) : 0;
+            out.write(reinterpret_cast<const char*>(&tn), sizeof(tn));
+        }
+        padTo(out, h.offVehicleOff);
+        uint32_t off = 0;
+        out.write(reinterpret_cast<const char*>(&off), sizeof(off));
+        for (const auto &s : slots_) {
+            if (s.occupied()) off += (uint32_t)s.getTicket().vehicleID.size();
+            out.write(reinterpret_cast<const char*>(&off), sizeof(off));
+        }
+        padTo(out, h.offVehicleBlob);
+        for (const auto &s : slots_) if (s.occupied()) out << s.getTicket().vehicleID;
+
+        padTo(out, h.offWaitType);
+        for (const auto &e : waitlist_) out.put((char)e.type);
+        padTo(out, h.offWaitOff);
+        off = 0;
+        out.write(reinterpret_cast<const char*>(&off), sizeof(off));
+        for (const auto &e : waitlist_) {
+            off += (uint32_t)e.vehicleID.size();
+            out.write(reinterpret_cast<const char*>(&off), sizeof(off));
+        }
+        padTo(out, h.offWaitBlob);
+        for (const auto &e : waitlist_) out << e.vehicleID;
+
+        padTo(out, h.offStats);
+        ExportStats st{};
+        st.totalVehiclesServed = totalVehiclesServed_;
+        st.totalEarnings = totalEarnings_;
+        st.typeCount = (uint32_t)vehicleClassCount();
+        for (int t = 0; t < vehicleClassCount(); ++t) st.ratePerHour[t] = ratePerHour_[t];
+        st.ticketCounter = ticketCounter_;
+        out.write(reinterpret_cast<const char*>(&st), sizeof(st));
+
+        if (!out) {
+            cout << "❗ Write error while exporting to \"" << path << "\".\n";
+            return false;
+        }
+        cout << "✅ Binary export written to \"" << path << "\" (" << h.fileSize << " bytes).\n";
+        return true;
+    }
+
+    // Print layout (1-based slot numbers for UX)
+    void printSlotsLayout() const {
+        cout << "\nSlots layout (Slot# : Type : Status)\n";
+        for (const auto &s: slots_) {
+            cout << "  " << (s.index() + 1) << " : " << vehicleTypeToStr(s.type())
+                 << " : ";
+            auto held = heldSlots_.find(s.index());
+            if (s.occupied() && s.closed()) cout << "DRAINING - " << s.getTicket().vehicleID << "\n";
+            else if (s.occupied()) cout << "OCC - " << s.getTicket().vehicleID << "\n";
+            else if (s.closed()) cout << "CLOSED\n";
+            else if (held != heldSlots_.end()) cout << "HELD - R" << held->second << "\n";
+            else cout << "FREE\n";
+        }
+    }
+};
+
+/* ------------------ LotAuditor ------------------
+   Background thread that verifies the lot in time slices: each slice takes
+   the caller's lot mutex, checks the next chunk with auditChunk() and lets
+   go, so gate batches wait at most one chunk (~4K slots) rather than a
+   full pass. Every writer to the lot must take the same mutex.
+   On a mismatch the chunk's diagnostic dump goes to onFailure (default:
+   a lot-audit-<unix time>.txt file, named on cerr); clean slices are only
+   counted.
+*/
+class LotAuditor {
+public:
+    using FailureHandler = function<void(size_t chunk, const AuditReport&, const string& dump)>;
+
+private:
+    const ParkingLot* lot_ = nullptr;
+    mutex* lotMutex_ = nullptr;
+    chrono::microseconds slice_{2000};
+    FailureHandler onFailure_;
+    thread worker_;
+    mutex waitMutex_;
+    condition_variable wake_;
+    bool stopping_ = false;
+    atomic<uint64_t> slices_{0}, passes_{0}, failures_{0};
+
+    static void writeDumpFile(size_t chunk, const AuditReport& r, const string& dump) {
+        string path = "lot-audit-" + to_string(chrono::duration_cast<chrono::seconds>(
+                          chrono::system_clock::now().time_since_epoch()).count()) + ".txt";
+        ofstream(path) << dump;
+        cerr << "❌ Lot audit: " << r.violations << " violation(s) in chunk " << chunk
+             << "; first: " << r.problems.front() << " (dump: " << path << ")\n";
+    }
+
+    void loop() {
+        size_t next = 0;
+        unique_lock<mutex> wl(waitMutex_);
+        while (!wake_.wait_for(wl, slice_, [this] { return stopping_; })) {
+            wl.unlock();
+            AuditReport r;
+            string dump;
+            size_t chunk = next;
+            {
+                lock_guard<mutex> g(*lotMutex_);
+                size_t chunks = lot_->auditChunkCount();
+                if (chunk >= chunks) chunk = 0;
+                r = lot_->auditChunk(chunk);
+                if (!r.ok()) {
+                    ostringstream o;
+                    lot_->dumpDiagnostics(o, chunk);
+                    dump = o.str();
+                }
+                next = chunk + 1;
+                if (next >= chunks) passes_.fetch_add(1, memory_order_relaxed);
+            }
+            slices_.fetch_add(1, memory_order_relaxed);
+            if (!r.ok()) {
+                failures_.fetch_add(1, memory_order_relaxed);
+                (onFailure_ ? onFailure_ : writeDumpFile)(chunk, r, dump);
+            }
+            wl.lock();
+        }
+    }
+
+public:
+    ~LotAuditor() { stop(); }
+
+    bool running() const { return worker_.joinable(); }
+    uint64_t slices() const { return slices_.load(); }
+    uint64_t passes() const { return passes_.load(); }     // full sweeps of the lot completed
+    uint64_t failures() const { return failures_.load(); }
+
+    // One chunk every 'slice'
+    bool start(const ParkingLot& lot, mutex& lotMutex, chrono::microseconds slice,
+               FailureHandler onFailure = nullptr) {
+        if (running()) return false;
+        lot_ = &lot;
+        lotMutex_ = &lotMutex;
+        slice_ = slice;
+        onFailure_ = move(onFailure);
+        stopping_ = false;
+        worker_ = thread([this] { loop(); });
+        return true;
+    }
+
+    void stop() {
+        if (!running()) return;
+        { lock_guard<mutex> g(waitMutex_); stopping_ = true; }
+        wake_.notify_all();
+        worker_.join();
+    }
+};
+
+/* ------------------ LotSnapshots ------------------
+   Versioned read-only views of a lot for reporting and export threads.
+   The writer publishes a fork() of the live lot wherever it may read it
+   (its owning thread or under its lock; tens of microseconds even for
+   1M slots). Readers pin the current version with no lock at all and
+   read it for as long as they need while the gates keep writing.
+
+   Reclamation is epoch based. Each publish bumps the epoch and retires
+   the previous version tagged with the new epoch. A pinning reader
+   announces the epoch it saw in its own slot before loading the version,
+   so a reader announced below a tag may still hold that version; one
+   whose announcement is at least the tag loaded something newer. A
+   retired version is freed by the writer (on publish or reclaim()) once
+   no pinned reader is announced below its tag: one scan of kMaxReaders
+   slots, no per-read reference counting.
+   Snapshot : the forked lot, its version number and lot time
+   Reader   : a registered reader slot; pin() one View at a time
+*/
+class LotSnapshots {
+public:
+    static const int kMaxReaders = 64;
+
+    struct Snapshot {
+        unique_ptr<const ParkingLot> lot;
+        uint64_t version = 0;
+        long long takenAt = 0;      // lot clock (minutes)
+    };
+
+    // A pinned snapshot; unpins when destroyed
+    class View {
+        atomic<uint64_t>* slot_ = nullptr;
+        const Snapshot* snap_ = nullptr;
+    public:
+        View() = default;
+        View(atomic<uint64_t>* slot, const Snapshot* snap) : slot_(slot), snap_(snap) {}
+        View(View&& o) noexcept : slot_(o.slot_), snap_(o.snap_) { o.slot_ = nullptr; o.snap_ = nullptr; }
+        View(const View&) = delete;
+        View& operator=(const View&) = delete;
+        ~View() { if (slot_) slot_->store(0, memory_order_release); }
+
+        explicit operator bool() const { return snap_ != nullptr; }
+        const ParkingLot& lot() const { return *snap_->lot; }
+        const ParkingLot* operator->() const { return snap_->lot.get(); }
+        uint64_t version() const { return snap_->version; }
+        long long takenAt() const { return snap_->takenAt; }
+    };
+
+    class Reader {
+        LotSnapshots* owner_ = nullptr;
+        int slot_ = -1;
+    public:
+        Reader() = default;
+        Reader(LotSnapshots* owner, int slot) : owner_(owner), slot_(slot) {}
+        Reader(Reader&& o) noexcept : owner_(o.owner_), slot_(o.slot_) { o.slot_ = -1; }
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+        ~Reader() { if (slot_ >= 0) owner_->inUse_[slot_].store(false, memory_order_release); }
+
+        explicit operator bool() const { return slot_ >= 0; }
+        // Latest published snapshot (empty View before the first publish)
+        View pin() {
+            atomic<uint64_t> &a = owner_->announced_[slot_];
+            a.store(owner_->epoch_.load(), memory_order_seq_cst);
+            const Snapshot* snap = owner_->current_.load(memory_order_seq_cst);
+            if (!snap) { a.store(0, memory_order_release); return View(); }
+            return View(&a, snap);
+        }
+    };
+
+private:
+    atomic<const Snapshot*> current_{nullptr};
+    atomic<uint64_t> epoch_{1};
+    array<atomic<uint64_t>, kMaxReaders> announced_{};   // epoch while pinned, 0 when not
+    array<atomic<bool>, kMaxReaders> inUse_{};
+    mutex writer_;                                        // publish/reclaim
+    vector<pair<const Snapshot*, uint64_t>> retired_;     // (snapshot, tag)
+    uint64_t versions_ = 0;
+    atomic<uint64_t> freed_{0};
+
+    void reclaimLocked() {
+        uint64_t oldest = UINT64_MAX;
+        for (auto &a : announced_) {
+            uint64_t e = a.load(memory_order_seq_cst);
+            if (e) oldest = min(oldest, e);
+        }
+        size_t kept = 0;
+        for (auto &r : retired_) {
+            if (r.second <= oldest) { delete r.first; freed_.fetch_add(1, memory_order_relaxed); }
+            else retired_[kept++] = r;
+        }
+        retired_.resize(kept);
+    }
+
+public:
+    ~LotSnapshots() {
+        for (auto &r : retired_) delete r.first;
+        delete current_.load();
+    }
+
+    // Register a reader thread; an empty Reader when all slots are taken
+    Reader reader() {
+        for (int i = 0; i < kMaxReaders; ++i) {
+            bool expected = false;
+            if (inUse_[i].compare_exchange_strong(expected, true, memory_order_acquire)) return Reader(this, i);
+        }
+        return Reader();
+    }
+
+    // Publish a fork of lot as the current snapshot; call where lot may be read
+    uint64_t publish(const ParkingLot& lot) {
+        auto *snap = new Snapshot{lot.fork(), 0, lot.now()};
+        lock_guard<mutex> g(writer_);
+        snap->version = ++versions_;
+        const Snapshot* old = current_.exchange(snap, memory_order_seq_cst);
+        uint64_t tag = epoch_.fetch_add(1, memory_order_seq_cst) + 1;
+        if (old) retired_.emplace_back(old, tag);
+        reclaimLocked();
+        return snap->version;
+    }
+
+    // Free retired snapshots no reader can still hold
+    void reclaim() {
+        lock_guard<mutex> g(writer_);
+        reclaimLocked();
+    }
+
+    uint64_t published() const { return epoch_.load() - 1; }
+    uint64_t freed() const { return freed_.load(); }
+    size_t retiredPending() {
+        lock_guard<mutex> g(writer_);
+        return retired_.size();
+    }
+};
+
+/* ------------------ LotExecutor ------------------
+   Minimal single-threaded run queue for coroutines resumed by the lot.
+   Resumptions are posted, never run inline, so a coroutine never resumes
+   while ParkingLot is in the middle of vehicleExit.
+*/
+class LotExecutor {
+private:
+    deque<coroutine_handle<>> ready_;
+public:
+    void post(coroutine_handle<> h) { ready_.push_back(h); }
+    bool idle() const { return ready_.empty(); }
+
+    // Resume everything posted so far (and anything those post); returns count
+    size_t runPending() {
+        size_t n = 0;
+        while (!ready_.empty()) {
+            coroutine_handle<> h = ready_.front();
+            ready_.pop_front();
+            h.resume();
+            ++n;
+        }
+        return n;
+    }
+};
+
+/* ------------------ LotTask ------------------
+   Fire-and-forget coroutine type for gate handlers: starts eagerly, frees
+   its frame when it finishes.
+*/
+struct LotTask {
+    struct promise_type {
+        LotTask get_return_object() { return {}; }
+        suspend_never initial_suspend() noexcept { return {}; }
+        suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { terminate(); }
+    };
+};
+
+/* ------------------ AsyncParkingLot ------------------
+   Awaitable wrapper over a ParkingLot:
+     LotResult r = co_await async.enter("KA01", VehicleType::CAR);
+   enter() completes at once when a slot is free; when the vehicle is
+   waitlisted the coroutine subscribes to its promotion, suspends, and is
+   resumed through the executor with the assigned slot in the result, or
+   with LEFT_WAITLIST if the vehicle leaves the waitlist first.
+   exit() and query() never suspend.
+*/
+class AsyncParkingLot {
+private:
+    ParkingLot& lot_;
+    LotExecutor& exec_;
+    size_t suspended_ = 0;
+
+public:
+    AsyncParkingLot(ParkingLot& lot, LotExecutor& exec) : lot_(lot), exec_(exec) {}
+    AsyncParkingLot(const AsyncParkingLot&) = delete;
+    AsyncParkingLot& operator=(const AsyncParkingLot&) = delete;
+
+    size_t suspendedEntries() const { return suspended_; }
+
+    // The entry itself is attempted when the awaiter is built, so
+    // await_ready() only inspects its outcome
+    struct EntryAwaiter {
+        AsyncParkingLot& self;
+        string vehicleID;
+        LotResult result;
+        EntryAwaiter(AsyncParkingLot& owner, string id, VehicleType vt)
+            : self(owner), vehicleID(move(id)), result(owner.lot_.vehicleEntry(vehicleID, vt)) {}
+        bool await_ready() const { return result.status != LotStatus::WAITLISTED; }
+        void await_suspend(coroutine_handle<> h) {
+            AsyncParkingLot* owner = &self;
+            LotResult* res = &result;
+            ++owner->suspended_;
+            self.lot_.subscribePromotion(vehicleID, [owner, res, h](const PromotionNotice& n) {
+                res->status = n.slotIndex >= 0 ? LotStatus::OK : LotStatus::LEFT_WAITLIST;
+                res->slotIndex = n.slotIndex;
+                res->waitPosition = 0;
+                --owner->suspended_;
+                owner->exec_.post(h);
+            });
+        }
+        LotResult await_resume() const { return result; }
+    };
+
+    struct ReadyAwaiter {
+        LotResult result;
+        bool await_ready() const { return true; }
+        void await_suspend(coroutine_handle<>) const {}
+        LotResult await_resume() const { return result; }
+    };
+
+    EntryAwaiter enter(string vehicleID, VehicleType vt) { return EntryAwaiter(*this, move(vehicleID), vt); }
+    ReadyAwaiter exit(const string& vehicleID, long long durationMinutes) {
+        return ReadyAwaiter{lot_.vehicleExit(vehicleID, durationMinutes)};
+    }
+    ReadyAwaiter query(const string& vehicleID) const { return ReadyAwaiter{lot_.queryVehicle(vehicleID)}; }
+};
+
+/* ------------------ Gate protocol ------------------
+   Little-endian binary frames over TCP. Clients may pipeline any number of
+   requests per connection; responses come back in request order.
+   Request : GateRequestHeader (16 bytes) followed by idLen bytes of vehicle ID
+             op ENTRY: vtype = VehicleType
+             op EXIT : arg = duration in minutes
+             op QUERY: no arguments
+   Response: GateResponse (24 bytes); status is a LotStatus, slot is 1-based
+             (0 = none), fee in rupees for EXIT. Followed by plateLen bytes
+             of plate: the plate exited (PLATE_CORRECTED) or the nearest
+             parked plate (AMBIGUOUS_PLATE); 0 otherwise.
+*/
+enum class GateOp : uint8_t { ENTRY = 1, EXIT = 2, QUERY = 3 };
+
+struct GateRequestHeader {
+    uint32_t requestId;
+    uint8_t op;
+    uint8_t vtype;
+    uint8_t idLen;
+    uint8_t reserved;
+    int64_t arg;
+};
+static_assert(sizeof(GateRequestHeader) == 16, "GateRequestHeader is a wire format");
+
+struct GateResponse {
+    uint32_t requestId;
+    uint8_t status;
+    uint8_t plateLen;
+    uint8_t reserved[2];
+    int32_t slot;
+    uint32_t waitPosition;
+    double fee;
+};
+static_assert(sizeof(GateResponse) == 24, "GateResponse is a wire format");
+
+/* ------------------ GateServer ------------------
+   Single-threaded epoll server that owns all access to one ParkingLot.
+   Each wakeup reads everything available on the ready connections, then
+   dispatches every complete frame from all of them as one batch before
+   flushing responses, so pipelined clients are served with one syscall
+   pair per batch rather than per request. A peer that closes its side
+   still has every complete frame it sent dispatched; its connection
+   closes once the responses are written (or the write fails). Binds to
+   loopback unless told otherwise: the protocol has no authentication.
+*/
+class GateServer {
+private:
+    struct Conn {
+        vector<char> in;
+        size_t inPos = 0;
+        vector<char> out;
+        size_t outPos = 0;
+        uint32_t armed = EPOLLIN;    // epoll interest currently registered
+        bool peerClosed = false;     // EOF, reset or hangup seen; no more input
+    };
+    ParkingLot& lot_;
+    int listenFd_ = -1, epollFd_ = -1, wakeFd_ = -1;
+    atomic<bool> running_{false};
+    unordered_map<int, Conn> conns_;
+    uint64_t served_ = 0;
+    mutex* lotMutex_ = nullptr;  // taken around each batch when the lot is shared (e.g. with a LotAuditor)
+    LotSnapshots* snapshots_ = nullptr;          // republished after a batch once 'snapshotEvery_' has passed
+    chrono::milliseconds snapshotEvery_{100};
+    chrono::steady_clock::time_point lastSnapshot_{};
+    uint64_t snapshotServed_ = 0;
+
+    // Publish a snapshot if the lot changed and one is due (lot readable here)
+    void maybeSnapshot() {
+        if (!snapshots_ || served_ == snapshotServed_) return;
+        auto now = chrono::steady_clock::now();
+        if (now - lastSnapshot_ < snapshotEvery_) return;
+        snapshots_->publish(lot_);
+        lastSnapshot_ = now;
+        snapshotServed_ = served_;
+    }
+
+    // epoll timeout: block until traffic unless a snapshot is still owed
+    int snapshotWaitMs() const {
+        if (!snapshots_ || served_ == snapshotServed_) return -1;
+        auto left = snapshotEvery_ - (chrono::steady_clock::now() - lastSnapshot_);
+        return (int)max<long long>(0, chrono::ceil<chrono::milliseconds>(left).count());
+    }
+
+    static void setNonBlocking(int fd) { fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK); }
+
+    void closeConn(int fd) {
+        epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        conns_.erase(fd);
+    }
+
+    // plate receives the bytes that follow the response (see protocol)
+    GateResponse execute(const GateRequestHeader& h, const string& vehicleID, string& plate) {
+        LotResult r;
+        switch ((GateOp)h.op) {
+            case GateOp::ENTRY:
+                if (h.vtype < vehicleClassCount()) r = lot_.vehicleEntry(vehicleID, (VehicleType)h.vtype);
+                else r.status = LotStatus::INVALID;
+                break;
+            case GateOp::EXIT:  r = lot_.vehicleExit(vehicleID, h.arg); break;
+            case GateOp::QUERY: r = lot_.queryVehicle(vehicleID); break;
+            default:            r.status = LotStatus::INVALID; break;
+        }
+        GateResponse resp{};
+        resp.requestId = h.requestId;
+        resp.status = (uint8_t)r.status;
+        resp.slot = r.slotIndex + 1;
+        resp.waitPosition = (uint32_t)r.waitPosition;
+        resp.fee = r.fee;
+        plate.assign(r.plate, 0, UINT8_MAX);
+        resp.plateLen = (uint8_t)plate.size();
+        ++served_;
+        return resp;
+    }
+
+    // Parse and run every complete frame buffered on a connection
+    void dispatch(Conn& c) {
+        string vehicleID, plate;
+        while (c.in.size() - c.inPos >= sizeof(GateRequestHeader)) {
+            GateRequestHeader h;
+            memcpy(&h, c.in.data() + c.inPos, sizeof(h));
+            if (c.in.size() - c.inPos < sizeof(h) + h.idLen) break;
+            vehicleID.assign(c.in.data() + c.inPos + sizeof(h), h.idLen);
+            c.inPos += sizeof(h) + h.idLen;
+            GateResponse resp = execute(h, vehicleID, plate);
+            const char* p = reinterpret_cast<const char*>(&resp);
+            c.out.insert(c.out.end(), p, p + sizeof(resp));
+            c.out.insert(c.out.end(), plate.begin(), plate.end());
+        }
+        // Compact once the consumed prefix dominates the buffer
+        if (c.inPos > 0 && c.inPos * 2 >= c.in.size()) {
+            c.in.erase(c.in.begin(), c.in.begin() + (ptrdiff_t)c.inPos);
+            c.inPos = 0;
+        }
+    }
+
+    // Write what the socket accepts; arm EPOLLOUT only while output is
+    // pending, and stop watching input once the peer has closed
+    bool flush(int fd, Conn& c) {
+        while (c.outPos < c.out.size()) {
+            ssize_t w = send(fd, c.out.data() + c.outPos, c.out.size() - c.outPos, MSG_NOSIGNAL);
+            if (w > 0) { c.outPos += (size_t)w; continue; }
+            if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            return false;
+        }
+        bool pending = c.outPos < c.out.size();
+        if (!pending) { c.out.clear(); c.outPos = 0; }
+        uint32_t want = (c.peerClosed ? 0u : (uint32_t)EPOLLIN) | (pending ? (uint32_t)EPOLLOUT : 0u);
+        if (want != c.armed) {
+            epoll_event ev{};
+            ev.events = want;
+            ev.data.fd = fd;
+            epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev);
+            c.armed = want;
+        }
+        return true;
+    }
+
+public:
+    explicit GateServer(ParkingLot& lot) : lot_(lot) {}
+    ~GateServer() {
+        for (auto &kv : conns_) close(kv.first);
+        if (listenFd_ >= 0) close(listenFd_);
+        if (epollFd_ >= 0) close(epollFd_);
+        if (wakeFd_ >= 0) close(wakeFd_);
+    }
+
+    uint64_t served() const { return served_; }
+    void setLotMutex(mutex* m) { lotMutex_ = m; }
+    // Keep 'snaps' at most 'every' behind the lot for lock-free readers
+    void setSnapshots(LotSnapshots* snaps, chrono::milliseconds every) {
+        snapshots_ = snaps;
+        snapshotEvery_ = every;
+    }
+
+    // Bind 127.0.0.1:port, or 0.0.0.0:port with allInterfaces (0 = any
+    // free port; see port())
+    bool listenOn(int port, bool allInterfaces = false) {
+        listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenFd_ < 0) return false;
+        int one = 1;
+        setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)port);
+        addr.sin_addr.s_addr = htonl(allInterfaces ? INADDR_ANY : INADDR_LOOPBACK);
+        if (::bind(listenFd_, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd_, 256) < 0) return false;
+        setNonBlocking(listenFd_);
+        epollFd_ = epoll_create1(0);
+        wakeFd_ = eventfd(0, EFD_NONBLOCK);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = listenFd_;
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, listenFd_, &ev);
+        ev.data.fd = wakeFd_;
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &ev);
+        return true;
+    }
+
+    int port() const {
+        sockaddr_in addr{};
+        socklen_t len = sizeof(addr);
+        if (listenFd_ < 0 || getsockname(listenFd_, (sockaddr*)&addr, &len) < 0) return -1;
+        return ntohs(addr.sin_port);
+    }
+
+    // Serve until stop(); call from the thread that owns the lot
+    void run() {
+        running_.store(true);
+        epoll_event events[256];
+        vector<int> ready;
+        char buf[64 * 1024];
+        while (running_.load(memory_order_acquire)) {
+            int n = epoll_wait(epollFd_, events, 256, snapshotWaitMs());
+            if (n < 0 && errno == EINTR) continue;
+            ready.clear();
+            for (int i = 0; i < n; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == wakeFd_) continue;
+                if (fd == listenFd_) {
+                    int c;
+                    while ((c = accept(listenFd_, nullptr, nullptr)) >= 0) {
+                        setNonBlocking(c);
+                        int one = 1;
+                        setsockopt(c, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                        epoll_event ev{};
+                        ev.events = EPOLLIN;
+                        ev.data.fd = c;
+                        epoll_ctl(epollFd_, EPOLL_CTL_ADD, c, &ev);
+                        conns_[c] = Conn{};
+                    }
+                    continue;
+                }
+                auto it = conns_.find(fd);
+                if (it == conns_.end()) continue;
+                Conn &c = it->second;
+                // Drain input even on hangup: frames already sent are still served
+                if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                    while (!c.peerClosed) {
+                        ssize_t r = read(fd, buf, sizeof(buf));
+                        if (r > 0) { c.in.insert(c.in.end(), buf, buf + r); continue; }
+                        if (r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) c.peerClosed = true;
+                        break;
+                    }
+                }
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) c.peerClosed = true;
+                ready.push_back(fd);
+            }
+            // Batched dispatch across all ready connections, then flush
+            if (lotMutex_) {
+                lock_guard<mutex> g(*lotMutex_);
+                for (int fd : ready) dispatch(conns_[fd]);
+                maybeSnapshot();
+            } else {
+                for (int fd : ready) dispatch(conns_[fd]);
+                maybeSnapshot();
+            }
+            for (int fd : ready) {
+                Conn &c = conns_[fd];
+                if (!flush(fd, c) || (c.peerClosed && c.out.empty())) closeConn(fd);
+            }
+        }
+    }
+
+    // Thread- and signal-safe
+    void stop() {
+        running_.store(false, memory_order_release);
+        uint64_t one = 1;
+        if (wakeFd_ >= 0 && write(wakeFd_, &one, sizeof(one)) < 0) { /* already woken */ }
+    }
+};
+
+/* ------------------ Gate load test ------------------
+   Each client thread keeps 'depth' requests in flight on its own
+   connection: a pipelined batch of ENTRYs, then EXITs for the same
+   vehicles. Reports aggregate operations per second.
+*/
+static bool writeAll(int fd, const char* p, size_t n) {
+    while (n) {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w <= 0) return false;
+        p += w; n -= (size_t)w;
+    }
+    return true;
+}
+
+static bool readAll(int fd, char* p, size_t n) {
+    while (n) {
+        ssize_t r = read(fd, p, n);
+        if (r <= 0) return false;
+        p += r; n -= (size_t)r;
+    }
+    return true;
+}
+
+// Read resps.size() pipelined responses, skipping the plate bytes after any of them
+static bool readResponses(int fd, vector<GateResponse>& resps, vector<char>& buf) {
+    buf.resize(resps.size() * sizeof(GateResponse));
+    if (!readAll(fd, buf.data(), buf.size())) return false;
+    size_t pos = 0;
+    for (auto &r : resps) {
+        memcpy(&r, buf.data() + pos, sizeof(r));
+        pos += sizeof(r);
+        if (r.plateLen) {
+            size_t old = buf.size();
+            buf.resize(old + r.plateLen);
+            if (!readAll(fd, buf.data() + old, r.plateLen)) return false;
+            pos += r.plateLen;
+        }
+    }
+    return true;
+}
+
+static void runGateLoadTest(int port, int clients, long long totalOps, int depth) {
+    atomic<long long> done{0}, failures{0};
+    long long perClient = max(2LL * depth, totalOps / clients);
+    auto client = [&](int cid) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) { failures += perClient; close(fd); return; }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        vector<string> ids;
+        for (int i = 0; i < depth; ++i) ids.push_back("C" + to_string(cid) + "-" + to_string(i));
+        vector<char> frame, in;
+        vector<GateResponse> resps(depth);
+        uint32_t reqId = 0;
+        long long ops = 0;
+        while (ops < perClient) {
+            for (GateOp op : {GateOp::ENTRY, GateOp::EXIT}) {
+                frame.clear();
+                for (int i = 0; i < depth; ++i) {
+                    GateRequestHeader h{};
+                    h.requestId = ++reqId;
+                    h.op = (uint8_t)op;
+                    h.vtype = (uint8_t)VehicleType::CAR;
+                    h.idLen = (uint8_t)ids[i].size();
+                    h.arg = 60;
+                    const char* p = reinterpret_cast<const char*>(&h);
+                    frame.insert(frame.end(), p, p + sizeof(h));
+                    frame.insert(frame.end(), ids[i].begin(), ids[i].end());
+                }
+                if (!writeAll(fd, frame.data(), frame.size()) ||
+                    !readResponses(fd, resps, in)) {
+                    failures += perClient - ops;
+                    close(fd);
+                    return;
+                }
+                for (const auto &r : resps) if (r.status != (uint8_t)LotStatus::OK) ++failures;
+                ops += depth;
+            }
+        }
+        done += ops;
+        close(fd);
+    };
+    auto t0 = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (int c = 0; c < clients; ++c) threads.emplace_back(client, c);
+    for (auto &t : threads) t.join();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    cout << "Gate load test: " << clients << " client(s), pipeline depth " << depth << "\n"
+         << "  ops      : " << done.load() << "\n"
+         << "  failures : " << failures.load() << "\n"
+         << "  elapsed  : " << fixed << setprecision(3) << secs << " s\n"
+         << "  rate     : " << setprecision(0) << done.load() / secs << " ops/sec\n";
+}
+
+/* ------------------ Async demo (run with --async-demo) ------------------
+   One car slot, three gate coroutines: the second and third suspend on
+   the waitlist; the third gives up and resumes with LEFT_WAITLIST, the
+   second resumes through the executor when the first vehicle leaves.
+*/
+static LotTask asyncGate(AsyncParkingLot& lot, string vehicleID, long long stayMinutes, vector<string>& log) {
+    LotResult in = co_await lot.enter(vehicleID, VehicleType::CAR);
+    if (in.status != LotStatus::OK) {
+        log.push_back(vehicleID + " gave up waiting");
+        co_return;
+    }
+    log.push_back(vehicleID + " parked in slot " + to_string(in.slotIndex + 1));
+    if (stayMinutes > 0) {
+        LotResult out = co_await lot.exit(vehicleID, stayMinutes);
+        log.push_back(vehicleID + " left, fee Rs " + to_string((long long)out.fee));
+    }
+}
+
+static void runAsyncDemo() {
+    ParkingLot lot;
+    lot.setVerbose(false);
+    lot.initialize(1, 0, 0);
+    LotExecutor exec;
+    AsyncParkingLot async(lot, exec);
+    vector<string> log;
+    asyncGate(async, "KA01", 0, log);        // parks and stays
+    asyncGate(async, "KA02", 30, log);       // lot full: suspends
+    asyncGate(async, "KA03", 30, log);       // suspends behind KA02
+    lot.leaveWaitlist("KA03");               // its resumption is posted
+    log.push_back("suspended entries: " + to_string(async.suspendedEntries()));
+    lot.vehicleExit("KA01", 90);             // promotes KA02, resumption is posted
+    log.push_back("executor resumed " + to_string(exec.runPending()) + " coroutine(s)");
+    for (const auto &line : log) cout << "  " << line << "\n";
+}
+
+/* -------------------- Helper functions for UI -------------------- */
+
+// parseType: map user input to VehicleType by configured name or alias
+// (case-insensitive, one perfect-hash probe); unknown input falls back to TRUCK
+static VehicleType parseType(const string& s) {
+    int ord = VehicleClassRegistry::instance().find(s);
+    return ord < 0 ? VehicleType::TRUCK : (VehicleType)ord;
+}
+
+// "car/bike/..." for prompts
+static string vehicleTypeChoices() {
+    string out;
+    for (int t = 0; t < vehicleClassCount(); ++t) {
+        string name = vehicleTypeToStr((VehicleType)t);
+        for (char &c : name) c = (char)tolower(c);
+        out += (t ? "/" : "") + name;
+    }
+    return out;
+}
+
+// inputPositiveInteger: robust numeric input reading for menu and minutes
+static long long inputPositiveInteger(const string &prompt) {
+    while (true) {
+        cout << prompt;
+        long long x;
+        if (!(cin >> x)) {
+            cin.clear();
+            string bad; getline(cin, bad);
+            cout << " ❗ Please enter a valid number.\n";
+            continue;
+        }
+        if (x < 0) {
+            cout << " ❗ Please enter a non-negative number.\n";
+            continue;
+        }
+        return x;
+    }
+}
+
+/* -------------------- Capacity simulator (run with --simulate) --------------------
+   Discrete-event simulation of a ParkingLot on a simulated clock, for
+   "what if" capacity questions. Arrivals per vehicle type are Poisson
+   (exponential gaps), dwell is log-normal (median, log-sd); alternatively a
+   recorded trace of (minute, type, dwell) is replayed or fitted. Waitlisted
+   vehicles subscribe to promotion and start their dwell when promoted, or
+   leave the waitlist after 'patience' minutes (lost revenue).
+   Every scenario runs 'runs' times with seeds seed, seed+1, ... so run k of
+   each scenario sees the same traffic (common random numbers): differences
+   between scenarios come from capacity, not luck. Runs go to all cores;
+   each owns its lot and RNG, and the variates are drawn from mt19937_64
+   with our own transforms, so results depend only on the seed.
+*/
+struct SimTraffic {
+    double perHour[kMaxVehicleClasses] = {0};   // mean arrivals per hour
+    double medianDwell[kMaxVehicleClasses] = {0};
+    double dwellSigma[kMaxVehicleClasses] = {0}; // sd of ln(dwell)
+
+    // Rough weekday mix for the built-in types
+    static SimTraffic defaults() {
+        SimTraffic t;
+        auto set = [&](VehicleType vt, double rate, double median, double sigma) {
+            if ((int)vt < vehicleClassCount()) { t.perHour[(int)vt] = rate; t.medianDwell[(int)vt] = median; t.dwellSigma[(int)vt] = sigma; }
+        };
+        set(VehicleType::CAR, 30, 120, 0.8);
+        set(VehicleType::BIKE, 15, 90, 0.8);
+        set(VehicleType::TRUCK, 2, 180, 0.6);
+        return t;
+    }
+};
+
+struct SimArrival {
+    double minute;
+    VehicleType type;
+    double dwell;
+};
+
+// Recorded arrivals, one "minute type dwell" per line (commas allowed, '#'
+// comments); sorted by minute. False with a message on the first bad line.
+static bool loadSimTrace(const string& path, vector<SimArrival>& out, string& err) {
+    ifstream in(path);
+    if (!in) { err = "cannot open " + path; return false; }
+    string line;
+    int lineNo = 0;
+    while (getline(in, line)) {
+        ++lineNo;
+        size_t hashPos = line.find('#');
+        if (hashPos != string::npos) line.resize(hashPos);
+        for (char &c : line) if (c == ',') c = ' ';
+        istringstream ls(line);
+        SimArrival a;
+        string type;
+        if (!(ls >> a.minute)) continue;
+        int ord = -1;
+        if (!(ls >> type >> a.dwell) || (ord = VehicleClassRegistry::instance().find(type)) < 0 || a.minute < 0 || a.dwell < 0) {
+            err = path + ":" + to_string(lineNo) + ": expected \"minute type dwell\"";
+            return false;
+        }
+        a.type = (VehicleType)ord;
+        out.push_back(a);
+    }
+    stable_sort(out.begin(), out.end(), [](const SimArrival& x, const SimArrival& y) { return x.minute < y.minute; });
+    return true;
+}
+
+// Maximum-likelihood Poisson rate and log-normal dwell per type from a trace
+static SimTraffic fitSimTraffic(const vector<SimArrival>& trace) {
+    SimTraffic t;
+    if (trace.empty()) return t;
+    double span = max(60.0, trace.back().minute - trace.front().minute);
+    double n[kMaxVehicleClasses] = {0}, sum[kMaxVehicleClasses] = {0}, sumSq[kMaxVehicleClasses] = {0};
+    for (const auto &a : trace) {
+        double l = log(max(1.0, a.dwell));
+        n[(int)a.type] += 1; sum[(int)a.type] += l; sumSq[(int)a.type] += l * l;
+    }
+    for (int v = 0; v < vehicleClassCount(); ++v) {
+        if (n[v] == 0) continue;
+        double mu = sum[v] / n[v];
+        t.perHour[v] = n[v] * 60.0 / span;
+        t.medianDwell[v] = exp(mu);
+        t.dwellSigma[v] = sqrt(max(0.0, sumSq[v] / n[v] - mu * mu));
+    }
+    return t;
+}
+
+struct SimScenario {
+    string name;
+    array<int, kMaxVehicleClasses> slots = perVehicleType(0);
+};
+
+// One run's outcome; measured after the warm-up only
+struct SimResult {
+    double occupiedMinutes[kMaxVehicleClasses] = {0};  // integral of occupied slots over time
+    double slotMinutes[kMaxVehicleClasses] = {0};
+    long long arrivals = 0, waitlisted = 0, gaveUp = 0, stillWaiting = 0;
+    LogHistogram wait;                                   // minutes on the waitlist
+    double revenue = 0.0;
+    double minutes = 0.0;
+
+    void merge(const SimResult& o) {
+        for (int t = 0; t < kMaxVehicleClasses; ++t) { occupiedMinutes[t] += o.occupiedMinutes[t]; slotMinutes[t] += o.slotMinutes[t]; }
+        arrivals += o.arrivals; waitlisted += o.waitlisted; gaveUp += o.gaveUp; stillWaiting += o.stillWaiting;
+        wait.merge(o.wait);
+        revenue += o.revenue;
+        minutes += o.minutes;
+    }
+};
+
+class LotSimulator {
+private:
+    struct Event {
+        double t;
+        uint64_t seq;
+        int kind;          // 0 = next synthetic arrival of 'type', 1 = departure, 2 = trace arrival, 3 = patience ends
+        int type;
+        long long vehicle;
+        double dwell;
+        bool operator>(const Event& o) const { return t != o.t ? t > o.t : seq > o.seq; }
+    };
+
+    mt19937_64 rng_;
+    priority_queue<Event, vector<Event>, greater<Event>> events_;
+    uint64_t seq_ = 0;
+    double now_ = 0.0;
+
+    // Portable variates: identical on every standard library for a seed
+    double uniform() { return ((rng_() >> 11) + 0.5) * (1.0 / 9007199254740992.0); }
+    double exponential(double rate) { return -log(uniform()) / rate; }
+    double normal() { return sqrt(-2.0 * log(uniform())) * cos(6.283185307179586 * uniform()); }
+    double logNormal(double median, double sigma) { return median * exp(sigma * normal()); }
+
+    void push(double t, int kind, int type, long long vehicle = 0, double dwell = 0) {
+        events_.push(Event{t, seq_++, kind, type, vehicle, dwell});
+    }
+
+public:
+    vector<string> names_;   // vehicle number -> vehicle ID
+    string prefix_ = "S";    // of simulated vehicle IDs
+    unordered_map<long long, pair<double,double>> waiting_;   // vehicle -> (arrival, dwell)
+
+    long long addVehicle(string id) {
+        names_.push_back(move(id));
+        return (long long)names_.size() - 1;
+    }
+
+    double sampleDwell(int type, const SimTraffic& traffic) {
+        return traffic.medianDwell[type] > 0 ? logNormal(traffic.medianDwell[type], traffic.dwellSigma[type]) : 60.0;
+    }
+
+    // Queue a waitlisted vehicle: when promoted it parks for 'dwell'
+    void awaitPromotion(ParkingLot& lot, long long id, bool measured, SimResult& res) {
+        lot.subscribePromotion(names_[id], [this, id, measured, &res](const PromotionNotice& n) {
+            if (n.slotIndex < 0) return;   // gave up: drive() already dropped it from waiting_
+            auto it = waiting_.find(id);
+            if (measured) res.wait.record((uint64_t)llround(now_ - it->second.first));
+            push(now_ + it->second.second, 1, (int)n.vtype, id, it->second.second);
+            waiting_.erase(it);
+        });
+    }
+
+    void drive(ParkingLot& lot, const SimTraffic& traffic, const vector<SimArrival>& trace,
+               double minutes, double warmup, double patience, SimResult& res) {
+        const LotMetrics &m = lot.metrics();
+        int types = vehicleClassCount();
+
+        if (trace.empty()) {
+            for (int v = 0; v < types; ++v)
+                if (traffic.perHour[v] > 0) push(exponential(traffic.perHour[v] / 60.0), 0, v);
+        } else {
+            for (size_t i = 0; i < trace.size(); ++i)
+                push(trace[i].minute - trace.front().minute, 2, (int)trace[i].type, 0, trace[i].dwell);
+        }
+
+        double last = 0.0;
+        auto advance = [&](double t) {
+            double from = max(last, warmup), to = max(t, warmup);
+            if (to > from)
+                for (int v = 0; v < types; ++v) {
+                    res.occupiedMinutes[v] += (double)m.occupied[v].load(memory_order_relaxed) * (to - from);
+                    res.slotMinutes[v] += (double)m.slots[v].load(memory_order_relaxed) * (to - from);
+                }
+            last = t;
+        };
+
+        while (!events_.empty() && events_.top().t < minutes) {
+            Event e = events_.top();
+            events_.pop();
+            advance(e.t);
+            now_ = e.t;
+            if (e.kind == 1) {
+                LotResult r = lot.vehicleExit(names_[e.vehicle], llround(e.dwell));
+                if (now_ >= warmup) res.revenue += r.fee;
+                continue;
+            }
+            if (e.kind == 3) {
+                auto it = waiting_.find(e.vehicle);
+                if (it == waiting_.end()) continue;      // promoted in time
+                if (it->second.first >= warmup) ++res.gaveUp;
+                waiting_.erase(it);
+                lot.leaveWaitlist(names_[e.vehicle]);
+                continue;
+            }
+            if (e.kind == 0) push(now_ + exponential(traffic.perHour[e.type] / 60.0), 0, e.type);
+            double dwell = e.kind == 2 ? e.dwell : sampleDwell(e.type, traffic);
+            long long id = addVehicle(prefix_ + to_string(names_.size()));
+            bool measured = now_ >= warmup;
+            if (measured) ++res.arrivals;
+            LotResult r = lot.vehicleEntry(names_[id], (VehicleType)e.type);
+            if (r.status == LotStatus::OK) {
+                push(now_ + dwell, 1, e.type, id, dwell);
+            } else if (r.status == LotStatus::WAITLISTED) {
+                if (measured) ++res.waitlisted;
+                waiting_[id] = {now_, dwell};
+                if (patience > 0) push(now_ + patience, 3, e.type, id);
+                awaitPromotion(lot, id, measured, res);
+            }
+        }
+        advance(minutes);
+        res.minutes = max(0.0, minutes - warmup);
+        for (const auto &w : waiting_) if (w.second.first >= warmup) ++res.stillWaiting;
+    }
+
+public:
+    explicit LotSimulator(uint64_t seed) : rng_(seed) {}
+
+    // Simulate 'minutes' of traffic on an empty lot of the scenario's
+    // capacity (trace replay when trace is non-empty); patience <= 0 waits
+    // forever
+    SimResult run(const SimScenario& sc, const SimTraffic& traffic, const vector<SimArrival>& trace,
+                  double minutes, double warmup, double patience) {
+        ParkingLot lot;
+        lot.setVerbose(false);
+        lot.setClock([this] { return (long long)now_; });
+        lot.initialize(sc.slots);
+        SimResult res;
+        drive(lot, traffic, trace, minutes, warmup, patience, res);
+        return res;
+    }
+
+    // Continue from a lot's current state (normally a fork of the live lot),
+    // with no warm-up. Parked vehicles leave after a fresh dwell sample for
+    // their type and waitlisted ones park for one once promoted (their
+    // history is unknown). The lot's clock is driven from its current time.
+    SimResult runFrom(ParkingLot& lot, const SimTraffic& traffic, double minutes, double patience) {
+        SimResult res;
+        prefix_ = "sim#";   // keep clear of real vehicle IDs
+        long long start = lot.now();
+        lot.setVerbose(false);
+        lot.setClock([this, start] { return start + (long long)now_; });
+        lot.forEachParked([&](const Ticket& t) {
+            double dwell = sampleDwell((int)t.vtype, traffic);
+            push(dwell, 1, (int)t.vtype, addVehicle(t.vehicleID), dwell);
+        });
+        lot.forEachWaiting([&](const WaitEntry& w) {
+            long long id = addVehicle(w.vehicleID);
+            waiting_[id] = {0.0, sampleDwell((int)w.type, traffic)};
+            awaitPromotion(lot, id, true, res);
+        });
+        drive(lot, traffic, {}, minutes, 0.0, patience, res);
+        return res;
+    }
+};
+
+// Per-scenario report, 'runs' results per scenario merged; deltas: the
+// scenario slots are changes to a live lot rather than capacities
+static void printSimResults(const vector<SimScenario>& scenarios, const vector<SimResult>& results, int runs, bool deltas) {
+    for (size_t s = 0; s < scenarios.size(); ++s) {
+        SimResult total;
+        for (int k = 0; k < runs; ++k) total.merge(results[s * runs + k]);
+        double occ = 0, cap = 0;
+        for (int v = 0; v < vehicleClassCount(); ++v) { occ += total.occupiedMinutes[v]; cap += total.slotMinutes[v]; }
+        double days = max(1e-9, total.minutes / 1440.0);
+        cout << "\n▶ " << scenarios[s].name << " :";
+        for (int v = 0; v < vehicleClassCount(); ++v)
+            if (scenarios[s].slots[v])
+                cout << " " << vehicleTypeToStr((VehicleType)v) << (deltas ? (scenarios[s].slots[v] > 0 ? "+" : "") : "=") << scenarios[s].slots[v];
+        cout << "\n  Utilisation        : " << setprecision(1) << (cap ? 100.0 * occ / cap : 0.0) << "% overall |";
+        for (int v = 0; v < vehicleClassCount(); ++v)
+            if (total.slotMinutes[v] > 0) cout << " " << vehicleTypeToStr((VehicleType)v) << " " << 100.0 * total.occupiedMinutes[v] / total.slotMinutes[v] << "%";
+        cout << "\n  Arrivals / run     : " << setprecision(0) << (double)total.arrivals / runs
+             << " | waitlisted " << setprecision(1) << (total.arrivals ? 100.0 * total.waitlisted / total.arrivals : 0.0) << "%"
+             << " | gave up " << (total.arrivals ? 100.0 * total.gaveUp / total.arrivals : 0.0) << "%"
+             << " | still waiting at end " << setprecision(0) << (double)total.stillWaiting / runs << "\n";
+        if (total.wait.count())
+            cout << "  Wait minutes       : p50 " << total.wait.quantile(0.5) << " | p90 " << total.wait.quantile(0.9)
+                 << " | p99 " << total.wait.quantile(0.99) << "\n";
+        cout << "  Revenue / day (Rs) : " << setprecision(2) << total.revenue / days << "\n";
+    }
+}
+
+// Run every scenario 'runs' times across all cores and print one report line
+// per scenario (runs merged)
+static void runSimulation(const vector<SimScenario>& scenarios, const SimTraffic& traffic, const vector<SimArrival>& trace,
+                          double minutes, double warmup, double patience, uint64_t seed, int runs) {
+    size_t tasks = scenarios.size() * (size_t)runs;
+    vector<SimResult> results(tasks);
+    atomic<size_t> next{0};
+    unsigned workers = max(1u, min<unsigned>(thread::hardware_concurrency(), (unsigned)tasks));
+    auto t0 = chrono::steady_clock::now();
+    vector<thread> pool;
+    for (unsigned w = 0; w < workers; ++w)
+        pool.emplace_back([&] {
+            for (size_t i; (i = next++) < tasks; ) {
+                LotSimulator sim(seed + i % runs);
+                results[i] = sim.run(scenarios[i / runs], traffic, trace, minutes, warmup, patience);
+            }
+        });
+    for (auto &th : pool) th.join();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    cout << fixed << setprecision(1);
+    cout << "\n📈 Simulation: " << (minutes - warmup) / 1440.0 << " day(s) measured after " << warmup / 60.0 << " h warm-up, "
+         << runs << " run(s) per scenario (seed " << seed;
+    if (runs > 1) cout << "-" << (seed + runs - 1);
+    cout << "), "
+         << (trace.empty() ? "synthetic traffic" : "trace replay") << ", " << setprecision(2) << secs << " s on " << workers << " thread(s)\n";
+    printSimResults(scenarios, results, runs, false);
+}
+
+// What-if from the live lot's current state: every (scenario, run) gets a
+// copy-on-write fork of the lot, taken here (the caller's thread, which
+// may read the lot), then changed by the scenario's slot deltas and driven
+// forward on a worker. Forks share every page they never write.
+static void runWhatIf(const ParkingLot& live, const vector<SimScenario>& scenarios, const SimTraffic& traffic,
+                      double hours, double patience, uint64_t seed, int runs) {
+    size_t tasks = scenarios.size() * (size_t)runs;
+    vector<unique_ptr<ParkingLot>> forks(tasks);
+    auto t0 = chrono::steady_clock::now();
+    for (auto &f : forks) f = live.fork();
+    double forkSecs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    vector<SimResult> results(tasks);
+    atomic<size_t> next{0};
+    unsigned workers = max(1u, min<unsigned>(thread::hardware_concurrency(), (unsigned)tasks));
+    t0 = chrono::steady_clock::now();
+    vector<thread> pool;
+    for (unsigned w = 0; w < workers; ++w)
+        pool.emplace_back([&] {
+            for (size_t i; (i = next++) < tasks; ) {
+                ParkingLot &lot = *forks[i];
+                lot.setVerbose(false);
+                const SimScenario &sc = scenarios[i / runs];
+                for (int t = 0; t < vehicleClassCount(); ++t) {
+                    if (sc.slots[t] > 0) lot.addSlots((VehicleType)t, sc.slots[t]);
+                    else if (sc.slots[t] < 0) lot.closeSlots((VehicleType)t, -sc.slots[t]);
+                }
+                LotSimulator sim(seed + i % runs);
+                results[i] = sim.runFrom(lot, traffic, hours * 60, patience);
+                forks[i].reset();
+            }
+        });
+    for (auto &th : pool) th.join();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    cout << fixed << setprecision(1);
+    cout << "\n🔀 What-if: next " << hours << " h from the current lot, " << runs << " run(s) per scenario, "
+         << tasks << " fork(s) in " << setprecision(0) << forkSecs * 1e6 << " us, "
+         << setprecision(2) << secs << " s on " << workers << " thread(s)\n";
+    printSimResults(scenarios, results, runs, true);
+}
+
+// Capacity changes such as "bike+200" or "car-10,ev+20" (slots hold deltas)
+static bool parseSimScenario(const string& spec, SimScenario& sc) {
+    sc = SimScenario{spec, {}};
+    string items = spec;
+    for (char &c : items) if (c == ',') c = ' ';
+    istringstream deltas(items);
+    string item;
+    while (deltas >> item) {
+        size_t op = item.find_first_of("+-");
+        int t = op == string::npos ? -1 : VehicleClassRegistry::instance().find(item.substr(0, op));
+        char *end = nullptr;
+        long delta = op == string::npos ? 0 : strtol(item.c_str() + op, &end, 10);
+        if (t < 0 || !ownsSlots((VehicleType)t) || !end || *end || end == item.c_str() + op + 1) return false;
+        sc.slots[t] += (int)delta;
+    }
+    return true;
+}
+
+/* --simulate [key=value ...] [SCENARIO ...]
+     slots=car:100,bike:50,...     baseline capacity (default car:100,bike:50,truck:10)
+     traffic=car:30/120/0.8,...    arrivals/hour / median dwell min / log-sd per type
+                                   (replaces the default mix; unlisted types get none)
+     trace=FILE                    replay recorded arrivals; add "fit" to fit
+                                   Poisson/log-normal to the trace and sample instead
+     days=7 warmup=24 (hours) patience=30 (minutes, 0 = forever) seed=1 runs=4
+   SCENARIO is a set of capacity changes against the baseline, e.g.
+   bike+200 or car-10,ev+20; the baseline always runs first. */
+static int runSimulateCommand(int argc, char** argv) {
+    auto typeOf = [](const string& name) { return VehicleClassRegistry::instance().find(name); };
+    vector<SimScenario> scenarios(1);
+    scenarios[0].name = "baseline";
+    for (auto [t, n] : {pair<VehicleType,int>{VehicleType::CAR, 100}, {VehicleType::BIKE, 50}, {VehicleType::TRUCK, 10}})
+        if ((int)t < vehicleClassCount()) scenarios[0].slots[(int)t] = n;
+    SimTraffic traffic = SimTraffic::defaults();
+    string tracePath;
+    bool fit = false;
+    double days = 7, warmupHours = 24, patience = 30;
+    uint64_t seed = 1;
+    int runs = 4;
+
+    for (int i = 0; i < argc; ++i) {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        string key = eq == string::npos ? arg : arg.substr(0, eq), val = eq == string::npos ? "" : arg.substr(eq + 1);
+        for (char &c : val) if (c == ',') c = ' ';
+        istringstream items(val);
+        string item;
+        if (key == "slots") {
+            scenarios[0].slots = perVehicleType(0);
+            while (items >> item) {
+                size_t colon = item.find(':');
+                int t = typeOf(item.substr(0, colon));
+                if (colon == string::npos || t < 0 || !ownsSlots((VehicleType)t)) { cout << "❗ Bad slots entry \"" << item << "\".\n"; return 1; }
+                scenarios[0].slots[t] = max(0, atoi(item.c_str() + colon + 1));
+            }
+        } else if (key == "traffic") {
+            traffic = SimTraffic();
+            while (items >> item) {
+                for (char &c : item) if (c == ':' || c == '/') c = ' ';
+                istringstream f(item);
+                string name;
+                double rate, median, sigma;
+                int t;
+                if (!(f >> name >> rate >> median >> sigma) || (t = typeOf(name)) < 0 || rate < 0 || median <= 0 || sigma < 0) {
+                    cout << "❗ Bad traffic entry (want type:rate/median/sigma).\n"; return 1;
+                }
+                traffic.perHour[t] = rate; traffic.medianDwell[t] = median; traffic.dwellSigma[t] = sigma;
+            }
+        } else if (key == "trace") tracePath = val;
+        else if (key == "fit") fit = true;
+        else if (key == "days") days = max(0.01, atof(val.c_str()));
+        else if (key == "warmup") warmupHours = max(0.0, atof(val.c_str()));
+        else if (key == "patience") patience = atof(val.c_str());
+        else if (key == "seed") seed = strtoull(val.c_str(), nullptr, 10);
+        else if (key == "runs") runs = max(1, atoi(val.c_str()));
+        else if (eq == string::npos) {
+            SimScenario sc;
+            if (!parseSimScenario(arg, sc)) { cout << "❗ Bad scenario \"" << arg << "\" (want e.g. bike+200).\n"; return 1; }
+            scenarios.push_back(sc);
+        } else {
+            cout << "❗ Unknown simulate option \"" << key << "\".\n";
+            return 1;
+        }
+    }
+    for (size_t s = 1; s < scenarios.size(); ++s)
+        for (int t = 0; t < kMaxVehicleClasses; ++t) scenarios[s].slots[t] = max(0, scenarios[0].slots[t] + scenarios[s].slots[t]);
+
+    vector<SimArrival> trace;
+    double warmup = warmupHours * 60, minutes = warmup + days * 1440;
+    if (!tracePath.empty()) {
+        string err;
+        if (!loadSimTrace(tracePath, trace, err)) { cout << "❗ Trace not loaded: " << err << "\n"; return 1; }
+        cout << "✅ Loaded " << trace.size() << " arrivals from \"" << tracePath << "\".\n";
+        if (fit) {
+            traffic = fitSimTraffic(trace);
+            trace.clear();
+        } else if (!trace.empty()) {
+            minutes = trace.back().minute - trace.front().minute + 1;   // replay the whole trace
+            warmup = min(warmup, minutes / 2);
+            runs = 1;                                                   // a replay is the same every run
+        }
+    }
+    runSimulation(scenarios, traffic, trace, minutes, warmup, patience, seed, runs);
+    return 0;
+}
+
+/* -------------------- Strategy benchmark (run with --bench) --------------------
+   First times initialize() on a 10M-slot lot (bulk pool build), fork()
+   of a 90% full 1M-slot lot, and partial-plate search and misread-plate
+   matching over 100k parked plates. Then the same workload for
+   every strategy:
+   fill a car-only lot to 90%, then a seeded random mix of exits and
+   entries. Reports operations per second.
+*/
+static void runStrategyBenchmark() {
+    {
+        const int bigCars = 6000000, bigBikes = 3000000, bigTrucks = 1000000;
+        cout << "Bulk initialize: " << (bigCars + bigBikes + bigTrucks) << " slots\n";
+        for (int st : {(int)AllocationStrategy::LOWEST_INDEX, (int)AllocationStrategy::ROUND_ROBIN}) {
+            ParkingLot lot;
+            lot.setVerbose(false);
+            lot.setStrategy((AllocationStrategy)st);
+            auto t0 = chrono::steady_clock::now();
+            lot.initialize(bigCars, bigBikes, bigTrucks);
+            double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+            cout << "  " << left << setw(14) << strategyToStr((AllocationStrategy)st) << right
+                 << fixed << setprecision(3) << setw(9) << secs << " s\n";
+        }
+    }
+
+    {
+        const int slots = 1000000, forks = 200;
+        ParkingLot lot;
+        lot.setVerbose(false);
+        lot.initialize(slots, 0, 0);
+        for (int i = 0; i < slots * 9 / 10; ++i) lot.vehicleEntry("F" + to_string(i), VehicleType::CAR);
+        vector<unique_ptr<ParkingLot>> copies;
+        copies.reserve(forks);
+        auto t0 = chrono::steady_clock::now();
+        for (int i = 0; i < forks; ++i) copies.push_back(lot.fork());
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        cout << "Fork: " << slots << " slots, 90% occupied\n  " << fixed << setprecision(1)
+             << secs * 1e6 / forks << " us per fork (" << forks << " live forks)\n";
+    }
+
+    {
+        const int parked = 100000, queries = 2000;
+        ParkingLot lot;
+        lot.setVerbose(false);
+        lot.initialize(parked, 0, 0);
+        lot.setPlateSearch(true);
+        mt19937 rng(7);
+        vector<string> plates;
+        for (int i = 0; i < parked; ++i) {
+            char p[16];
+            snprintf(p, sizeof(p), "KA%02u%c%c%04u", (unsigned)(rng() % 100), char('A' + rng() % 26), char('A' + rng() % 26), (unsigned)(rng() % 10000));
+            plates.push_back(p);
+        }
+        auto t0 = chrono::steady_clock::now();
+        for (const auto &p : plates) lot.vehicleEntry(p, VehicleType::CAR);
+        double fill = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        size_t hits = 0;
+        t0 = chrono::steady_clock::now();
+        for (int q = 0; q < queries; ++q) {
+            const string &p = plates[rng() % plates.size()];
+            hits += lot.findPlates(q & 1 ? p.substr(6, 3) : p.substr(0, 5), !(q & 1)).size();
+        }
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        cout << "Plate search: " << parked << " parked\n  " << fixed << setprecision(1)
+             << fill * 1e6 / parked << " us per indexed entry, " << secs * 1e6 / queries << " us per search ("
+             << hits / queries << " hits avg)\n";
+
+        // Misread plates: one O/0-style confusion, then one arbitrary substitution
+        lot.setExitPlateMatching(1.0);
+        for (double dist : {0.5, 1.0}) {
+            t0 = chrono::steady_clock::now();
+            for (int q = 0; q < queries / 10; ++q) {
+                string p = plates[rng() % plates.size()];
+                p[2 + rng() % 2] = dist < 1 ? 'O' : 'X';
+                lot.matchPlates(p, dist);
+            }
+            secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+            cout << "  " << secs * 1e6 / (queries / 10) << " us per misread match within " << dist << "\n";
+        }
+    }
+
+    const int numSlots = 20000;
+    const int numOps = 400000;
+    vector<string> ids;
+    ids.reserve(numSlots * 2);
+    for (int i = 0; i < numSlots * 2; ++i) ids.push_back("V" + to_string(i));
+
+    cout << "Strategy benchmark: " << numSlots << " slots, " << numOps << " ops\n";
+    for (int st = 0; st < kAllocationStrategyCount; ++st) {
+        ParkingLot lot;
+        lot.setVerbose(false);
+        lot.setSlotsPerLevel(100);
+        lot.initialize(numSlots, 0, 0);
+        lot.setStrategy((AllocationStrategy)st);
+
+        mt19937 rng(42);
+        vector<int> parked, idle;
+        for (int i = 0; i < (int)ids.size(); ++i) idle.push_back(i);
+        shuffle(idle.begin(), idle.end(), rng);
+        auto enter = [&]() {
+            int id = idle.back(); idle.pop_back();
+            lot.vehicleEntry(ids[id], VehicleType::CAR);
+            parked.push_back(id);
+        };
+        while ((int)parked.size() < numSlots * 9 / 10) enter();
+
+        auto t0 = chrono::steady_clock::now();
+        for (int op = 0; op < numOps; ++op) {
+            bool doExit = parked.size() == (size_t)numSlots || (!parked.empty() && (rng() & 1));
+            if (doExit) {
+                size_t k = rng() % parked.size();
+                int id = parked[k];
+                parked[k] = parked.back(); parked.pop_back();
+                lot.vehicleExit(ids[id], 60);
+                idle.push_back(id);
+            } else {
+                enter();
+            }
+        }
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        cout << "  " << left << setw(14) << strategyToStr((AllocationStrategy)st) << right
+             << fixed << setprecision(0) << setw(12) << (numOps / secs) << " ops/sec\n";
+    }
+}
+
+/* -------------------- Self-test (run with --selftest) --------------------
+   Behavioural checks for the engine, one group per feature. A group gets a
+   SelfTest, records each check through it and leaves no files or threads
+   behind. runSelfTest prints the failing checks and returns how many failed.
+*/
+struct SelfTest {
+    int checks = 0, failures = 0;
+
+    void check(bool ok, const string& what) {
+        ++checks;
+        if (!ok) { ++failures; cout << "  ❌ " << what << "\n"; }
+    }
+
+    // Scratch file path for a group; removed by the group itself
+    static string scratchPath(const string& name) {
+        const char* dir = getenv("TMPDIR");
+        return string(dir && *dir ? dir : "/tmp") + "/parking_selftest_" + to_string(getpid()) + "_" + name;
+    }
+
+    // Silences cout while alive (exports and displays report on it unconditionally)
+    class Quiet {
+        ostringstream sink_;   // declared first: constructed before cout is pointed at it
+        streambuf* saved_;
+    public:
+        Quiet() : saved_(cout.rdbuf(sink_.rdbuf())) {}
+        ~Quiet() { cout.rdbuf(saved_); }
+    };
+};
+
+static string slurpFile(const string& path) {
+    ifstream in(path, ios::binary);
+    return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+// Export: the binary columns and the CSV rows carry back every slot, the
+// waitlist in order and the billing totals
+static void selfTestExport(SelfTest& t) {
+    ParkingLot lot;
+    lot.setVerbose(false);
+    lot.initialize(3, 1, 0);
+    lot.vehicleEntry("EXPA", VehicleType::CAR);
+    lot.vehicleEntry("EXPB", VehicleType::CAR);
+    lot.vehicleEntry("EXPBIKE", VehicleType::BIKE);
+    double fee = lot.vehicleExit("EXPA", 90).fee;
+    lot.vehicleEntry("EXPC", VehicleType::CAR);
+    lot.vehicleEntry("EXPD", VehicleType::CAR);
+    lot.vehicleEntry("EXPWAIT1", VehicleType::CAR);
+    lot.vehicleEntry("EXPWAIT2", VehicleType::BIKE);
+
+    // Expected columns, from the public query API
+    vector<pair<int, string>> parked;   // slot -> vehicle
+    lot.forEachParked([&parked](const Ticket& tk) { parked.push_back({tk.slotIndex, tk.vehicleID}); });
+    vector<string> waiting;
+    lot.forEachWaiting([&waiting](const WaitEntry& w) { waiting.push_back(w.vehicleID); });
+
+    string bin = SelfTest::scratchPath("export.bin"), csv = SelfTest::scratchPath("export");
+    bool written;
+    {
+        SelfTest::Quiet quiet;
+        written = lot.exportBinary(bin) && lot.exportCSV(csv);
+    }
+    t.check(written, "export: files written");
+
+    string data = slurpFile(bin);
+    ExportHeader h{};
+    bool headerOk = data.size() >= sizeof(h);
+    if (headerOk) memcpy(&h, data.data(), sizeof(h));
+    headerOk = headerOk && memcmp(h.magic, "PLEXPRT1", 8) == 0 && h.headerSize == sizeof(h) && h.fileSize == data.size();
+    t.check(headerOk, "export: binary header matches the file");
+    if (headerOk) {
+        auto column = [&data](uint64_t off) { return data.data() + off; };
+        uint32_t vOff[16], wOff[16];
+        bool ok = h.slotCount == 4 && h.waitCount == 2;
+        if (ok) {
+            memcpy(vOff, column(h.offVehicleOff), (h.slotCount + 1) * sizeof(uint32_t));
+            memcpy(wOff, column(h.offWaitOff), (h.waitCount + 1) * sizeof(uint32_t));
+            vector<pair<int, string>> got;
+            for (uint64_t i = 0; i < h.slotCount; ++i) {
+                bool occ = column(h.offSlotOcc)[i] != 0;
+                ok = ok && (occ == (vOff[i + 1] > vOff[i]));
+                if (occ) got.push_back({(int)i, string(column(h.offVehicleBlob) + vOff[i], vOff[i + 1] - vOff[i])});
+            }
+            ok = ok && got == parked && (uint8_t)column(h.offSlotType)[3] == (uint8_t)VehicleType::BIKE;
+            vector<string> gotWait;
+            for (uint64_t i = 0; i < h.waitCount; ++i)
+                gotWait.push_back(string(column(h.offWaitBlob) + wOff[i], wOff[i + 1] - wOff[i]));
+            ok = ok && gotWait == waiting;
+        }
+        t.check(ok, "export: binary slot and waitlist columns round-trip");
+        ExportStats st{};
+        memcpy(&st, column(h.offStats), sizeof(st));
+        t.check(st.totalVehiclesServed == 5 && st.ticketCounter == 5 && st.totalEarnings == fee
+                    && st.typeCount == (uint32_t)vehicleClassCount(),
+                "export: binary stats round-trip");
+    }
+
+    istringstream slots(slurpFile(csv + "_slots.csv"));
+    string line;
+    vector<pair<int, string>> csvParked;
+    int rows = 0;
+    getline(slots, line);
+    while (getline(slots, line)) {
+        ++rows;
+        vector<string> f;
+        stringstream ls(line);
+        for (string cell; getline(ls, cell, ',');) f.push_back(cell);
+        if (f.size() >= 4 && f[2] == "1") csvParked.push_back({stoi(f[0]) - 1, f[3]});
+    }
+    t.check(rows == 4 && csvParked == parked, "export: CSV slot rows round-trip");
+    istringstream waits(slurpFile(csv + "_waitlist.csv"));
+    vector<string> csvWaiting;
+    getline(waits, line);
+    while (getline(waits, line)) csvWaiting.push_back(line.substr(line.find(',') + 1, line.rfind(',') - line.find(',') - 1));
+    t.check(csvWaiting == waiting, "export: CSV waitlist keeps its order");
+
+    for (const string& p : {bin, csv + "_slots.csv", csv + "_waitlist.csv", csv + "_stats.csv"}) unlink(p.c_str());
+}
+
+// Event feed: every transition is published gap-free, and a reader that
+// falls behind the ring skips ahead without ever seeing a torn event
+static void selfTestEvents(SelfTest& t) {
+    ParkingLot lot;
+    lot.setVerbose(false);
+    lot.initialize(1, 0, 0);
+    EventSubscriber sub = lot.subscribe();
+    lot.vehicleEntry("EVA", VehicleType::CAR);
+    lot.vehicleEntry("EVB", VehicleType::CAR);
+    lot.vehicleExit("EVA", 60);
+    lot.setRate(VehicleType::CAR, 55.0);
+    vector<LotEvent> seen;
+    for (LotEvent ev; sub.poll(ev);) seen.push_back(ev);
+    vector<LotEventKind> kinds;
+    bool gapFree = true;
+    for (size_t i = 0; i < seen.size(); ++i) {
+        kinds.push_back(seen[i].kind);
+        gapFree = gapFree && (i == 0 || seen[i].seq == seen[i - 1].seq + 1);
+    }
+    vector<LotEventKind> want = {LotEventKind::SlotAssigned, LotEventKind::Waitlisted, LotEventKind::SlotReleased,
+                                 LotEventKind::WaitlistPromoted, LotEventKind::RateChanged};
+    t.check(kinds == want && gapFree && sub.lost() == 0, "events: transitions published in order");
+    t.check(seen.size() == 5 && string(seen[3].vehicleID) == "EVB" && seen[3].slotIndex == 0 && seen[4].value == 55.0,
+            "events: payload carries vehicle, slot and value");
+
+    EventRing ring(8);
+    for (int i = 0; i < 20; ++i) ring.publish(LotEvent{});
+    EventSubscriber late(ring, 1);
+    LotEvent ev;
+    t.check(late.poll(ev) && ev.seq == 13 && late.lost() == 12, "events: overrun reader skips to the oldest kept event");
 
-// Helper to convert enum to printable string
-static string vehicleTypeToStr(VehicleType vt) {
-    if (vt == VehicleType::CAR) return "CAR";
-    if (vt == VehicleType::BIKE) return "BIKE";
-    return "TRUCK";
+    // A reader racing the producer sees each event whole or not at all
+    EventRing shared(64);
+    const int kEvents = 200000;
+    atomic<bool> done{false};
+    bool torn = false, ordered = true;
+    uint64_t got = 0;
+    thread reader([&] {
+        EventSubscriber s(shared, 1);
+        uint64_t last = 0;
+        LotEvent e;
+        while (true) {
+            bool finished = done.load(memory_order_acquire);
+            while (s.poll(e)) {
+                ++got;
+                ordered = ordered && e.seq > last;
+                last = e.seq;
+                torn = torn || e.value != (double)e.seq || e.slotIndex != (int32_t)(e.seq * 7);
+            }
+            if (finished) break;
+        }
+        got += s.lost();
+    });
+    for (int i = 1; i <= kEvents; ++i) {
+        LotEvent e;
+        e.value = i;
+        e.slotIndex = i * 7;
+        shared.publish(e);
+    }
+    done.store(true, memory_order_release);
+    reader.join();
+    t.check(!torn && ordered && got == (uint64_t)kEvents, "events: concurrent reader never sees a torn event");
 }
 
-/* ------------------ Ticket ------------------
-   Simple POD representing a parking ticket.
-   id       : generated ticket id (e.g. "T1")
-   vehicleID: registration or unique id provided by user
-   vtype    : vehicle type
-   slotIndex: internal 0-based index of assigned slot
-*/
-class Ticket {
-public:
-    string id;
-    string vehicleID;
-    VehicleType vtype;
-    int slotIndex; // internal 0-based index
+// Allocators: each strategy hands out the slot its rule names, checked
+// against a plain set under random churn, and a lot churning under every
+// strategy keeps its pools consistent with its slots
+static void selfTestAllocators(SelfTest& t) {
+    const int kSlots = 96, kPerLevel = 16;
+    auto dist = make_shared<vector<int>>(kSlots);
+    mt19937 rng(11);
+    for (int &d : *dist) d = (int)(rng() % 20);
+    vector<pair<string, unique_ptr<SlotAllocator>>> pools;
+    pools.emplace_back("lowest-index", make_unique<LowestIndexAllocator>());
+    pools.emplace_back("distance", make_unique<DistanceAllocator>(dist, true));
+    pools.emplace_back("round-robin", make_unique<RoundRobinAllocator>());
+    pools.emplace_back("level-fill", make_unique<LevelFillAllocator>(kPerLevel));
+    for (auto &[name, pool] : pools) {
+        vector<int> all(kSlots);
+        for (int i = 0; i < kSlots; ++i) all[i] = i;
+        pool->bulkLoad(all);
+        set<int> model(all.begin(), all.end());
+        int cursor = 0;
+        bool ok = true;
+        for (int op = 0; op < 4000 && ok; ++op) {
+            int r = (int)(rng() % 3);
+            if (r == 0 && !model.empty()) {
+                int want;
+                if (name == "lowest-index") {
+                    want = *model.begin();
+                } else if (name == "distance") {
+                    want = *min_element(model.begin(), model.end(),
+                                        [&](int a, int b) { return make_pair((*dist)[a], a) < make_pair((*dist)[b], b); });
+                } else if (name == "round-robin") {
+                    auto it = model.lower_bound(cursor);
+                    want = it != model.end() ? *it : *model.begin();
+                    cursor = want + 1;
+                } else {
+                    array<int, kSlots / kPerLevel> freeIn{};
+                    for (int idx : model) ++freeIn[idx / kPerLevel];
+                    int best = -1;
+                    for (int l = 0; l < (int)freeIn.size(); ++l)
+                        if (freeIn[l] > 0 && (best < 0 || freeIn[l] < freeIn[best])) best = l;
+                    want = *model.lower_bound(best * kPerLevel);
+                }
+                ok = pool->acquire() == want;
+                model.erase(want);
+            } else if (r == 1 && !model.empty()) {
+                int idx = (int)(rng() % kSlots);
+                if (!model.count(idx)) continue;
+                pool->erase(idx);
+                model.erase(idx);
+            } else {
+                int idx = (int)(rng() % kSlots);
+                pool->release(idx);
+                model.insert(idx);
+            }
+            ok = ok && pool->size() == model.size();
+        }
+        for (int i = 0; i < kSlots && ok; ++i) ok = pool->contains(i) == (model.count(i) > 0);
+        t.check(ok, "allocator " + name + ": picks match the strategy's rule");
+    }
 
-    Ticket() = default;
-    // Accept by const-ref for clarity and safety (no moves required)
-    Ticket(const string& tid, const string& vid, VehicleType vt, int idx)
-        : id(tid), vehicleID(vid), vtype(vt), slotIndex(idx) {}
-};
+    for (int st = 0; st < kAllocationStrategyCount; ++st) {
+        ParkingLot lot;
+        lot.setVerbose(false);
+        lot.setSlotsPerLevel(50);
+        lot.initialize(200, 0, 0);
+        lot.setStrategy((AllocationStrategy)st);
+        mt19937 churn(7);
+        for (int op = 0; op < 5000; ++op) {
+            string id = "CH" + to_string(churn() % 300);
+            if (lot.queryVehicle(id).status == LotStatus::OK) lot.vehicleExit(id, 30);
+            else lot.vehicleEntry(id, VehicleType::CAR);
+        }
+        t.check(lot.audit().ok(), string("allocator churn: ") + strategyToStr((AllocationStrategy)st));
+    }
+}
 
-/* ------------------ Slot ------------------
-   Represents one parking slot.
-   index_   : 0-based slot index
-   type_    : allowed vehicle type for this slot
-   occupied_: whether slot is occupied
-   ticket_  : ticket info when occupied
-*/
-class Slot {
-private:
-    int index_;
-    VehicleType type_;
-    bool occupied_;
-    Ticket ticket_; // valid only if occupied_
-public:
-    Slot() = default;
-    Slot(int idx, VehicleType vt) : index_(idx), type_(vt), occupied_(false) {}
+// Multi-bay vehicles: runs are contiguous and never straddle a busy slot,
+// a freed run promotes a waiting multi-bay vehicle, and a lazy-deletion
+// heap stays within twice its free count under erase/release churn
+static void selfTestMultiBay(SelfTest& t) {
+    // The built-in bay counts may be overridden by a class file: use the
+    // first multi-bay class and the single-bay class owning its slots
+    int multi = -1;
+    for (int ty = 0; ty < vehicleClassCount() && multi < 0; ++ty)
+        if (baysFor((VehicleType)ty) > 1) multi = ty;
+    if (multi >= 0) {
+        VehicleType mt = (VehicleType)multi, st = slotTypeFor(mt);
+        int bays = baysFor(mt);
+        string name = vehicleTypeToStr(mt);
+        array<int, kMaxVehicleClasses> counts{};
+        counts[(int)st] = 1 + 2 * bays;
+        ParkingLot lot;
+        lot.setVerbose(false);
+        lot.initialize(counts);
+        lot.vehicleEntry("MBSINGLE", st);
+        LotResult m1 = lot.vehicleEntry("MBRUN1", mt);
+        LotResult m2 = lot.vehicleEntry("MBRUN2", mt);
+        t.check(m1.status == LotStatus::OK && m1.slotIndex == 1 && m2.status == LotStatus::OK && m2.slotIndex == 1 + bays,
+                "multi-bay: " + name + " runs placed back to back");
+        lot.vehicleExit("MBSINGLE", 30);
+        t.check(lot.vehicleEntry("MBRUN3", mt).status == LotStatus::WAITLISTED,
+                "multi-bay: a single free bay does not take a " + name);
+        lot.vehicleExit("MBRUN1", 30);
+        LotResult q = lot.queryVehicle("MBRUN3");
+        t.check(q.status == LotStatus::OK && q.slotIndex == 1, "multi-bay: freed run passes to the waiting " + name);
+        t.check(lot.vehicleExit("MBRUN2", 30).status == LotStatus::OK && lot.audit().ok(), "multi-bay: audit after exits");
+    }
 
-    int index() const { return index_; }             // 0-based internal
-    VehicleType type() const { return type_; }
-    bool occupied() const { return occupied_; }
+    auto dist = make_shared<vector<int>>(64, 0);
+    DistanceAllocator heap(dist, true);
+    vector<int> all(64);
+    for (int i = 0; i < 64; ++i) all[i] = i;
+    heap.bulkLoad(all);
+    size_t worst = 0;
+    for (int op = 0; op < 20000; ++op) {
+        heap.erase(op % 64);
+        heap.release(op % 64);
+        worst = max(worst, heap.heapEntries());
+    }
+    t.check(worst <= 2 * heap.size() + 1, "multi-bay: lazy-deletion heap stays bounded under churn");
+}
 
-    // assign a ticket and mark occupied
-    void assignTicket(const Ticket& t) {
-        ticket_ = t;
-        occupied_ = true;
+// Reservations: overlapping windows are capped at the slot count, a hold
+// starts at the window and keeps walk-ins out, and a no-show hold expires
+static void selfTestReservations(SelfTest& t) {
+    ParkingLot lot;
+    lot.setVerbose(false);
+    long long now = 0;
+    lot.setClock([&now] { return now; });
+    lot.initialize(2, 0, 0);
+    long long r1 = lot.reserve("A", VehicleType::CAR, 60, 120);
+    long long r2 = lot.reserve("B", VehicleType::CAR, 90, 150);
+    t.check(r1 > 0 && r2 > 0, "reservations: two overlapping windows fit two slots");
+    t.check(lot.reserve("C", VehicleType::CAR, 100, 110) < 0, "reservations: a third overlapping window is refused");
+    t.check(lot.reserve("D", VehicleType::CAR, 150, 200) > 0, "reservations: windows are half-open");
+    t.check(lot.reserve("E", VehicleType::CAR, 50, 40) < 0, "reservations: empty window refused");
+    t.check(lot.cancelReservation(r1), "reservations: cancel");
+    long long r3 = lot.reserve("C", VehicleType::CAR, 100, 110);
+    t.check(r3 > 0, "reservations: cancelled capacity is reusable");
+
+    now = 100;
+    t.check(lot.vehicleEntry("WALKIN", VehicleType::CAR).status == LotStatus::WAITLISTED,
+            "reservations: held slots are kept from walk-ins");
+    t.check(lot.claimReservation(r3, "RSVC"), "reservations: claim inside the window");
+    t.check(!lot.claimReservation(r3, "RSVC2"), "reservations: a claim is used once");
+    now = 151;
+    t.check(!lot.claimReservation(r2, "RSVB"), "reservations: no-show hold expires at the window end");
+    t.check(lot.queryVehicle("RSVC").status == LotStatus::OK && lot.audit().ok(), "reservations: audit");
+}
+
+// Forecaster: bucket counts are kept per 5 minutes, a weekly pattern is
+// projected into the same window of the next week, and copies are isolated
+static void selfTestForecaster(SelfTest& t) {
+    const int B = OccupancyForecaster::kBucketMinutes, W = OccupancyForecaster::kWeekBuckets;
+    OccupancyForecaster f;
+    f.record(2, VehicleType::CAR, 1);
+    f.record(3, VehicleType::CAR, 1);
+    f.record(7, VehicleType::CAR, -1);
+    t.check(f.bucketCounts(0, VehicleType::CAR) == make_pair(2u, 0u) && f.bucketCounts(1, VehicleType::CAR) == make_pair(0u, 1u),
+            "forecaster: counts land in their 5-minute buckets");
+
+    // Four weeks of the same rush: +5 per bucket for an hour, then -5 for an hour
+    OccupancyForecaster weekly;
+    for (int week = 0; week < 4; ++week) {
+        long long base = (long long)week * W + 96;
+        for (int k = 0; k < 12; ++k) weekly.record((base + k) * B, VehicleType::CAR, 5);
+        for (int k = 12; k < 24; ++k) weekly.record((base + k) * B, VehicleType::CAR, -5);
     }
-    // release ticket and mark free
-    Ticket releaseTicket() {
-        Ticket t = ticket_;
-        occupied_ = false;
-        ticket_ = Ticket{};
-        return t;
+    long long before = (4LL * W + 95) * B;
+    vector<int> rush = weekly.forecast(before, VehicleType::CAR, 0, 1000, 2);
+    t.check(rush.size() == 2 && rush[0] >= 30 && rush[0] <= 50 && rush[1] <= 5, "forecaster: weekly rush projected");
+    vector<int> quiet = weekly.forecast(before + 6 * 60, VehicleType::CAR, 0, 1000, 2);
+    t.check(quiet == vector<int>({0, 0}), "forecaster: quiet window stays empty");
+    t.check(weekly.forecast(before, VehicleType::CAR, 0, 1000, 2) == rush, "forecaster: forecast leaves the state unchanged");
+    t.check(weekly.forecast(before, VehicleType::CAR, 0, 20, 2)[0] == 20, "forecaster: clamped to capacity");
+
+    OccupancyForecaster copy = f;
+    copy.record(8, VehicleType::CAR, 1);
+    t.check(f.bucketCounts(1, VehicleType::CAR) == make_pair(0u, 1u) && copy.bucketCounts(1, VehicleType::CAR) == make_pair(1u, 1u),
+            "forecaster: a copy records without touching the original");
+}
+
+// Statistics: histogram quantiles stay within the sketch's error, merged
+// sketches answer as one, and a merged peak is reported as a sum of peaks
+static void selfTestStatistics(SelfTest& t) {
+    LogHistogram all, lo, hi;
+    vector<uint64_t> values;
+    mt19937 rng(5);
+    for (int i = 0; i < 20000; ++i) {
+        uint64_t v = rng() % 100000;
+        values.push_back(v);
+        all.record(v);
+        (i % 2 ? hi : lo).record(v);
     }
-    const Ticket& getTicket() const { return ticket_; }
-};
+    sort(values.begin(), values.end());
+    bool close = true;
+    for (double q : {0.5, 0.9, 0.99}) {
+        double exact = (double)values[(size_t)ceil(q * values.size()) - 1];
+        close = close && fabs(all.quantile(q) - exact) <= 0.04 * exact + 1;
+    }
+    t.check(close, "statistics: quantiles within the sketch error");
+    lo.merge(hi);
+    bool same = lo.count() == all.count();
+    for (double q : {0.0, 0.5, 0.9, 0.99, 1.0}) same = same && lo.quantile(q) == all.quantile(q);
+    t.check(same, "statistics: merged halves answer like one sketch");
 
-/* ------------------ WaitEntry ------------------
-   Simple struct used in the FIFO waitlist queue.
-*/
-struct WaitEntry {
-    string vehicleID;
-    VehicleType type;
-    WaitEntry(string v = "", VehicleType t = VehicleType::CAR) : vehicleID(v), type(t) {}
-};
+    ParkingLot a, b;
+    for (ParkingLot* lot : {&a, &b}) {
+        lot->setVerbose(false);
+        lot->initialize(4, 0, 0);
+        lot->vehicleEntry("STA", VehicleType::CAR);
+        lot->vehicleEntry("STB", VehicleType::CAR);
+        lot->vehicleExit("STA", 45);
+    }
+    t.check(a.statistics().dwell[(int)VehicleType::CAR].count() == 1 && a.statistics().peakOccupied == 2,
+            "statistics: exits and the peak are tracked");
+    ostringstream single, merged;
+    a.statistics().display(single);
+    LotStatistics region = a.statistics();
+    region.merge(b.statistics());
+    region.display(merged);
+    t.check(single.str().find("Peak occupied slots") != string::npos
+                && merged.str().find("Sum of per-lot peaks  : 4") != string::npos && region.exits == 2,
+            "statistics: a merged peak is labelled as a sum of per-lot peaks");
+}
 
-/* ------------------ ParkingLot ------------------
-   Encapsulates all data structures and operations:
-    - slots_           : vector<Slot> (main storage)
-    - freeCars_/freeBikes_/freeTrucks_ : min-heaps storing free slot indices by type
-    - vehicleToSlot_   : unordered_map vehicleID -> slot index
-    - waitlist_        : queue<WaitEntry> FIFO
-    - rates & stats
-*/
-class ParkingLot {
-private:
-    vector<Slot> slots_;
-    priority_queue<int, vector<int>, greater<int>> freeCars_;
-    priority_queue<int, vector<int>, greater<int>> freeBikes_;
-    priority_queue<int, vector<int>, greater<int>> freeTrucks_;
-    unordered_map<string,int> vehicleToSlot_; // vehicleID -> slot index
-    queue<WaitEntry> waitlist_;
-    long long ticketCounter_ = 0;
+// Client socket to 127.0.0.1:port, -1 if the connect fails
+static int connectLoopback(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd >= 0 && connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0) return fd;
+    if (fd >= 0) close(fd);
+    return -1;
+}
 
-    // Stats & rates
-    long long totalVehiclesServed_ = 0;
-    double totalEarnings_ = 0.0;
-    unordered_map<VehicleType, double> ratePerHour_ {
-        {VehicleType::CAR, 50.0},
-        {VehicleType::BIKE, 20.0},
-        {VehicleType::TRUCK, 100.0}
-    };
+// One HTTP/1.0 GET; the whole response, empty on failure
+static string httpGet(int port, const string& path) {
+    int fd = connectLoopback(port);
+    if (fd < 0) return "";
+    string req = "GET " + path + " HTTP/1.0\r\n\r\n", resp;
+    if (writeAll(fd, req.data(), req.size())) {
+        char buf[4096];
+        ssize_t r;
+        while ((r = read(fd, buf, sizeof(buf))) > 0) resp.append(buf, (size_t)r);
+    }
+    close(fd);
+    return resp;
+}
 
-    // Generate next ticket id
-    string nextTicketID() { return "T" + to_string(++ticketCounter_); }
+// Metrics endpoint: /metrics renders the lot's gauges, added pages and
+// 404s are served, and clients that vanish mid-request do not stop it
+static void selfTestMetricsServer(SelfTest& t) {
+    ParkingLot lot;
+    lot.setVerbose(false);
+    lot.initialize(3, 0, 0);
+    lot.vehicleEntry("METRA", VehicleType::CAR);
+    MetricsServer server;
+    server.addPage("/hello", [] { return string("hello\n"); });
+    bool started = server.start(lot.metrics(), 0);
+    t.check(started && server.port() > 0, "metrics: server listens on loopback");
+    if (!started) return;
+    string m = httpGet(server.port(), "/metrics");
+    t.check(m.compare(0, 15, "HTTP/1.0 200 OK") == 0 && m.find("parking_slots{type=\"CAR\"} 3\n") != string::npos
+                && m.find("parking_slots_occupied{type=\"CAR\"} 1\n") != string::npos,
+            "metrics: /metrics renders the lot's gauges");
+    string page = httpGet(server.port(), "/hello?x=1");
+    t.check(page.compare(0, 15, "HTTP/1.0 200 OK") == 0 && page.size() > 6 && page.substr(page.size() - 6) == "hello\n",
+            "metrics: added page served");
+    t.check(httpGet(server.port(), "/nope").compare(0, 22, "HTTP/1.0 404 Not Found") == 0, "metrics: unknown path is 404");
 
-    // Return heap reference for a vehicle type
-    priority_queue<int, vector<int>, greater<int>>& heapFor(VehicleType vt) {
-        if (vt == VehicleType::CAR) return freeCars_;
-        if (vt == VehicleType::BIKE) return freeBikes_;
-        return freeTrucks_;
+    // Clients that reset right after asking or close without a full request
+    for (int i = 0; i < 20; ++i) {
+        int fd = connectLoopback(server.port());
+        if (fd < 0) continue;
+        linger lg{1, 0};
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        string req = i % 2 ? "GET /metrics HTTP/1.0\r\n\r\n" : "GET /met";
+        writeAll(fd, req.data(), req.size());
+        close(fd);
     }
+    lot.vehicleEntry("METRB", VehicleType::CAR);
+    t.check(httpGet(server.port(), "/metrics").find("parking_slots_occupied{type=\"CAR\"} 2\n") != string::npos,
+            "metrics: served after clients reset mid-request");
+    int port = server.port();
+    server.stop();
+    int late = connectLoopback(port);
+    t.check(!server.running() && late < 0, "metrics: stop closes the listener");
+    if (late >= 0) close(late);
+}
 
-public:
-    ParkingLot() = default;
+// One gate request frame appended to out
+static void appendGateFrame(vector<char>& out, uint32_t id, GateOp op, const string& vehicleID,
+                            VehicleType vt = VehicleType::CAR, int64_t arg = 0) {
+    GateRequestHeader h{};
+    h.requestId = id;
+    h.op = (uint8_t)op;
+    h.vtype = (uint8_t)vt;
+    h.idLen = (uint8_t)vehicleID.size();
+    h.arg = arg;
+    const char* p = reinterpret_cast<const char*>(&h);
+    out.insert(out.end(), p, p + sizeof(h));
+    out.insert(out.end(), vehicleID.begin(), vehicleID.end());
+}
 
-    // Initialize parking slots: contiguous blocks of car, bike, truck
-    void initialize(int numCars, int numBikes, int numTrucks) {
-        slots_.clear();
-        while(!freeCars_.empty()) freeCars_.pop();
-        while(!freeBikes_.empty()) freeBikes_.pop();
-        while(!freeTrucks_.empty()) freeTrucks_.pop();
-        vehicleToSlot_.clear();
-        while(!waitlist_.empty()) waitlist_.pop();
-        ticketCounter_ = 0;
-        totalVehiclesServed_ = 0;
-        totalEarnings_ = 0.0;
+// Gate protocol: pipelined frames are answered in order with plates where
+// due, a frame split across writes is reassembled, and a client that
+// half-closes after pipelining still gets every response
+static void selfTestGateServer(SelfTest& t) {
+    ParkingLot lot;
+    lot.setVerbose(false);
+    lot.initialize(2, 0, 0);
+    lot.setExitPlateMatching(1.0);
+    GateServer server(lot);
+    bool listening = server.listenOn(0);
+    t.check(listening && server.port() > 0, "gate: server listens on loopback");
+    if (!listening) return;
+    thread serverThread([&server] { server.run(); });
 
-        int idx = 0;
-        for(int i=0;i<numCars;++i) { slots_.emplace_back(idx, VehicleType::CAR); freeCars_.push(idx++); }
-        for(int i=0;i<numBikes;++i){ slots_.emplace_back(idx, VehicleType::BIKE); freeBikes_.push(idx++); }
-        for(int i=0;i<numTrucks;++i){ slots_.emplace_back(idx, VehicleType::TRUCK); freeTrucks_.push(idx++); }
+    int fd = connectLoopback(server.port());
+    vector<char> frames, buf;
+    appendGateFrame(frames, 1, GateOp::ENTRY, "KA01AB1234");
+    appendGateFrame(frames, 2, GateOp::ENTRY, "GATEB");
+    appendGateFrame(frames, 3, GateOp::ENTRY, "GATEC");
+    appendGateFrame(frames, 4, GateOp::QUERY, "GATEB");
+    appendGateFrame(frames, 5, GateOp::EXIT, "KA01A81234", VehicleType::CAR, 90);
+    appendGateFrame(frames, 6, (GateOp)9, "GATEB");
+    appendGateFrame(frames, 7, GateOp::QUERY, "GATEC");
+    vector<GateResponse> resps(7);
+    bool answered = fd >= 0 && writeAll(fd, frames.data(), frames.size()) && readResponses(fd, resps, buf);
+    bool inOrder = answered;
+    for (size_t i = 0; answered && i < resps.size(); ++i) inOrder = inOrder && resps[i].requestId == i + 1;
+    t.check(inOrder, "gate: pipelined requests answered in order");
+    t.check(answered && resps[0].status == (uint8_t)LotStatus::OK && resps[0].slot == 1
+                && resps[2].status == (uint8_t)LotStatus::WAITLISTED && resps[2].waitPosition == 1
+                && resps[3].slot == 2 && resps[5].status == (uint8_t)LotStatus::INVALID
+                && resps[6].status == (uint8_t)LotStatus::OK && resps[6].slot == 1,
+            "gate: entry, waitlist, query and bad-op statuses");
+    string plate = answered ? string(buf.data() + 5 * sizeof(GateResponse), resps[4].plateLen) : "";
+    t.check(answered && resps[4].status == (uint8_t)LotStatus::PLATE_CORRECTED && resps[4].fee > 0 && plate == "KA01AB1234",
+            "gate: corrected exit carries the plate");
 
-        cout << "\n✅ Parking initialized: Total slots = " << slots_.size()
-             << "  (Cars: " << numCars << ", Bikes: " << numBikes << ", Trucks: " << numTrucks << ")\n";
+    // A frame delivered in two writes
+    frames.clear();
+    appendGateFrame(frames, 8, GateOp::QUERY, "GATEB");
+    bool split = fd >= 0 && writeAll(fd, frames.data(), 10);
+    this_thread::sleep_for(chrono::milliseconds(20));
+    resps.assign(1, GateResponse{});
+    split = split && writeAll(fd, frames.data() + 10, frames.size() - 10) && readResponses(fd, resps, buf);
+    t.check(split && resps[0].requestId == 8 && resps[0].slot == 2, "gate: split frame reassembled");
+    if (fd >= 0) close(fd);
+
+    // Pipeline then half-close: every frame sent before the FIN is served
+    const int kFrames = 5000;
+    fd = connectLoopback(server.port());
+    frames.clear();
+    for (int i = 0; i < kFrames; ++i) appendGateFrame(frames, 100 + i, GateOp::QUERY, "GATEC");
+    resps.assign(kFrames, GateResponse{});
+    bool all = fd >= 0 && writeAll(fd, frames.data(), frames.size()) && shutdown(fd, SHUT_WR) == 0
+               && readResponses(fd, resps, buf);
+    t.check(all && resps.back().requestId == 100 + kFrames - 1 && read(fd, buf.data(), 1) == 0,
+            "gate: half-closed client gets every response, then EOF");
+    if (fd >= 0) close(fd);
+
+    server.stop();
+    serverThread.join();
+    t.check(lot.queryVehicle("KA01AB1234").status == LotStatus::NOT_FOUND && lot.audit().ok(), "gate: lot audit after serving");
+}
+
+// Records what a gate coroutine's entry resolved to
+static LotTask selfTestAwaitEntry(AsyncParkingLot& lot, string vehicleID, LotResult& out, bool& done) {
+    out = co_await lot.enter(vehicleID, VehicleType::CAR);
+    done = true;
+}
+
+// Async API: a free slot completes at once, a waitlisted entry suspends
+// and resumes through the executor with its slot or with LEFT_WAITLIST
+static void selfTestAsync(SelfTest& t) {
+    ParkingLot lot;
+    lot.setVerbose(false);
+    lot.initialize(1, 0, 0);
+    LotExecutor exec;
+    AsyncParkingLot async(lot, exec);
+    LotResult a, b, c, d;
+    bool aDone = false, bDone = false, cDone = false, dDone = false;
+    selfTestAwaitEntry(async, "ASYA", a, aDone);
+    t.check(aDone && a.status == LotStatus::OK && exec.idle(), "async: free slot completes without suspending");
+    selfTestAwaitEntry(async, "ASYB", b, bDone);
+    selfTestAwaitEntry(async, "ASYC", c, cDone);
+    selfTestAwaitEntry(async, "ASYD", d, dDone);
+    t.check(!bDone && !cDone && !dDone && async.suspendedEntries() == 3, "async: waitlisted entries suspend");
+    lot.leaveWaitlist("ASYC");
+    lot.unsubscribePromotion("ASYD");
+    t.check(!cDone && exec.runPending() == 2 && cDone && dDone, "async: resumption runs on the executor");
+    t.check(c.status == LotStatus::LEFT_WAITLIST && c.slotIndex == -1 && d.status == LotStatus::LEFT_WAITLIST,
+            "async: leaving or unsubscribing resumes with LEFT_WAITLIST");
+    lot.vehicleExit("ASYA", 30);
+    exec.runPending();
+    t.check(bDone && b.status == LotStatus::OK && b.slotIndex == 0 && async.suspendedEntries() == 0,
+            "async: promotion resumes with the slot");
+}
+
+// Promotion notices: the subscriber hears its slot and ticket once, an
+// eventfd is signalled with slot + 1, deferred notices wait for dispatch,
+// and leaving the waitlist sends the callback a slotIndex -1 notice
+static void selfTestPromotionNotices(SelfTest& t) {
+    ParkingLot lot;
+    lot.setVerbose(false);
+    lot.initialize(2, 0, 0);
+    lot.vehicleEntry("NOTA", VehicleType::CAR);
+    lot.vehicleEntry("NOTB", VehicleType::CAR);
+    for (const char* id : {"NOTC", "NOTD", "NOTE"}) lot.vehicleEntry(id, VehicleType::CAR);
+    vector<PromotionNotice> heard;
+    lot.subscribePromotion("NOTC", [&heard](const PromotionNotice& n) { heard.push_back(n); });
+    int efd = eventfd(0, EFD_NONBLOCK);
+    lot.subscribePromotionFd("NOTD", efd);
+    lot.subscribePromotion("NOTE", [&heard](const PromotionNotice& n) { heard.push_back(n); });
+
+    lot.vehicleExit("NOTB", 30);
+    t.check(heard.size() == 1 && heard[0].vehicleID == "NOTC" && heard[0].slotIndex == 1 && !heard[0].ticketID.empty()
+                && lot.queryVehicle("NOTC").slotIndex == 1,
+            "notices: promoted subscriber hears its slot and ticket");
+    lot.setDeferredNotifications(true);
+    lot.vehicleExit("NOTA", 30);
+    uint64_t v = 0;
+    t.check(read(efd, &v, sizeof(v)) < 0, "notices: deferred until dispatch");
+    t.check(lot.dispatchNotifications() == 1 && read(efd, &v, sizeof(v)) == sizeof(v) && v == 1,
+            "notices: eventfd signalled with slot + 1");
+    lot.setDeferredNotifications(false);
+
+    lot.leaveWaitlist("NOTE");
+    t.check(heard.size() == 2 && heard[1].vehicleID == "NOTE" && heard[1].slotIndex == -1 && heard[1].ticketID.empty(),
+            "notices: leaving the waitlist notifies with no slot");
+    lot.vehicleExit("NOTC", 30);
+    t.check(heard.size() == 2 && read(efd, &v, sizeof(v)) < 0, "notices: each subscription fires once");
+    close(efd);
+}
+
+// Vehicle types: every 1-bay class reserves and claims a slot of its own
+// slot type, and multi-bay classes are refused a reservation
+static void selfTestVehicleTypes(SelfTest& t) {
+    array<int, kMaxVehicleClasses> counts{};
+    array<int, kMaxVehicleClasses> first{};
+    int next = 0;
+    for (int st = 0; st < vehicleClassCount(); ++st) {
+        if (!ownsSlots((VehicleType)st)) continue;
+        counts[st] = 2;
+        first[st] = next;
+        next += 2;
+    }
+    ParkingLot lot;
+    lot.setVerbose(false);
+    long long now = 0;
+    lot.setClock([&now] { return now; });
+    lot.initialize(counts);
+    for (int ty = 0; ty < vehicleClassCount(); ++ty) {
+        VehicleType vt = (VehicleType)ty;
+        string name = vehicleTypeToStr(vt), plate = "RSV" + to_string(ty);
+        long long id = lot.reserve("selftest", vt, now + 10, now + 70);
+        if (baysFor(vt) > 1) { t.check(id < 0, name + ": multi-bay reservation refused"); continue; }
+        t.check(id > 0, name + ": reservation booked");
+        if (id <= 0) continue;
+        now += 10;
+        t.check(lot.claimReservation(id, plate), name + ": reservation claimed");
+        int st = (int)slotTypeFor(vt);
+        LotResult q = lot.queryVehicle(plate);
+        t.check(q.status == LotStatus::OK && q.slotIndex >= first[st] && q.slotIndex < first[st] + counts[st],
+                name + ": parked in a " + vehicleTypeToStr((VehicleType)st) + " slot");
+        t.check(lot.vehicleExit(plate, 60).status == LotStatus::OK, name + ": exit after claim");
     }
+    t.check(lot.audit().ok(), "vehicle types: audit");
+}
 
-    // Update hourly rate (parameter renamed to 'rate' for clarity)
-    void setRate(VehicleType vt, double rate) {
-        ratePerHour_[vt] = rate;
+// Garage topology: a layout file builds levels, zones and gates, entry
+// through a gate takes the nearest level with room, the per-level free
+// counts follow every entry and exit, and a bad layout leaves the lot as is
+static void selfTestTopology(SelfTest& t) {
+    string path = SelfTest::scratchPath("layout.conf");
+    {
+        ofstream out(path);
+        out << "site Selftest\nramp 100\n"
+            << "level G\nzone GA CAR 4 0\nzone GB BIKE 2 10   # bikes by the door\n"
+            << "level L1\nzone L1A CAR 4 0\n"
+            << "gate Ground G 0\ngate Upper L1 0\n";
     }
+    ParkingLot lot;
+    lot.setVerbose(false);
+    bool loaded = lot.loadLayout(path);
+    t.check(loaded && lot.topology() && lot.topology()->levelCount() == 2 && lot.topology()->slotCount() == 10,
+            "topology: layout loaded");
+    if (!loaded) { unlink(path.c_str()); return; }
+    t.check(lot.levelFreeCount(0, VehicleType::CAR) == 4 && lot.levelFreeCount(0, VehicleType::BIKE) == 2
+                && lot.levelFreeCount(1, VehicleType::CAR) == 4,
+            "topology: per-level free counts");
+    t.check(lot.vehicleEntryAt("TOPUP", VehicleType::CAR, 1).slotIndex == 6 && lot.vehicleEntryAt("TOPDN", VehicleType::CAR, 0).slotIndex == 0
+                && lot.levelFreeCount(1, VehicleType::CAR) == 3 && lot.levelFreeCount(0, VehicleType::CAR) == 3,
+            "topology: entry takes the gate's own level first");
+    for (int i = 0; i < 3; ++i) lot.vehicleEntryAt("TOPFILL" + to_string(i), VehicleType::CAR, 1);
+    LotResult spill = lot.vehicleEntryAt("TOPSPILL", VehicleType::CAR, 1);
+    t.check(lot.levelFreeCount(1, VehicleType::CAR) == 0 && spill.slotIndex >= 0 && lot.topology()->levelOf(spill.slotIndex) == 0,
+            "topology: a full level spills to the next nearest");
+    lot.vehicleExit("TOPUP", 30);
+    t.check(lot.levelFreeCount(1, VehicleType::CAR) == 1 && lot.audit().ok(), "topology: exit returns the level's slot");
 
-    // Entry: allocate nearest free slot using min-heap; if none, add to waitlist
-    void vehicleEntry(const string& vehicleID, VehicleType vt) {
-        if (vehicleToSlot_.count(vehicleID)) {
-            cout << "❗ Vehicle \"" << vehicleID << "\" already parked in slot " << (vehicleToSlot_[vehicleID] + 1) << "\n";
-            return;
-        }
-        auto &heap = heapFor(vt);
-        if (!heap.empty()) {
-            int slotIdx = heap.top(); heap.pop();
-            string tid = nextTicketID();
-            Ticket t(tid, vehicleID, vt, slotIdx);
-            slots_[slotIdx].assignTicket(t);
-            vehicleToSlot_[vehicleID] = slotIdx;
-            totalVehiclesServed_++;
-            cout << "\n🎫 Ticket: " << tid << "  | Vehicle: " << vehicleID
-                 << " | Type: " << vehicleTypeToStr(vt) << " | Slot#: " << (slotIdx + 1) << "\n";
-        } else {
-            waitlist_.emplace(vehicleID, vt);
-            cout << "\n⏳ No free " << vehicleTypeToStr(vt) << " slots. Added to waitlist position " << waitlist_.size() << "\n";
-        }
+    {
+        ofstream out(path);
+        out << "level G\nzone GA CAR 4 0\nstairs 3\n";
     }
+    t.check(!lot.loadLayout(path) && lot.topology()->slotCount() == 10 && lot.queryVehicle("TOPDN").status == LotStatus::OK,
+            "topology: a bad layout leaves the lot untouched");
+    unlink(path.c_str());
+}
 
-    // Exit: user supplies duration in minutes; calculate fee; free slot; serve waitlist if applicable
-    void vehicleExit(const string& vehicleID, long long durationMinutes) {
-        auto it = vehicleToSlot_.find(vehicleID);
-        if (it == vehicleToSlot_.end()) {
-            cout << "❗ Vehicle \"" << vehicleID << "\" not found.\n";
-            return;
-        }
-        int slotIdx = it->second;
-        Slot &s = slots_[slotIdx];
-        if (!s.occupied()) {
-            cout << "⚠️ Internal inconsistency: slot not occupied.\n";
-            vehicleToSlot_.erase(it);
-            return;
-        }
+// Capacity changes: added slots serve the waitlist, an occupied slot that
+// is closed drains and is never reassigned, reopening serves the waitlist
+// again, and only free slots may change type
+static void selfTestCapacity(SelfTest& t) {
+    ParkingLot lot;
+    lot.setVerbose(false);
+    lot.initialize(1, 0, 0);
+    const LotMetrics& m = lot.metrics();
+    lot.vehicleEntry("CAPA", VehicleType::CAR);
+    lot.vehicleEntry("CAPB", VehicleType::CAR);
+    t.check(lot.addSlots(VehicleType::CAR, 2) == 1 && lot.queryVehicle("CAPB").slotIndex == 1
+                && m.slots[(int)VehicleType::CAR].load() == 3,
+            "capacity: added slots serve the waitlist");
+    t.check(lot.decommissionSlot(0) == LotStatus::OK && lot.decommissionSlot(0) == LotStatus::INVALID
+                && lot.queryVehicle("CAPA").slotIndex == 0,
+            "capacity: closing an occupied slot lets it drain");
+    lot.vehicleExit("CAPA", 30);
+    t.check(lot.vehicleEntry("CAPC", VehicleType::CAR).slotIndex == 2
+                && lot.vehicleEntry("CAPD", VehicleType::CAR).status == LotStatus::WAITLISTED
+                && m.slots[(int)VehicleType::CAR].load() == 2,
+            "capacity: a drained slot is not reassigned");
+    t.check(lot.reopenSlot(0) == LotStatus::OK && lot.queryVehicle("CAPD").slotIndex == 0, "capacity: reopening serves the waitlist");
+    t.check(lot.retypeSlot(2, VehicleType::BIKE) == LotStatus::DUPLICATE, "capacity: an occupied slot keeps its type");
+    lot.vehicleExit("CAPC", 30);
+    t.check(lot.retypeSlot(2, VehicleType::BIKE) == LotStatus::OK && lot.vehicleEntry("CAPBIKE", VehicleType::BIKE).slotIndex == 2
+                && lot.vehicleEntry("CAPE", VehicleType::CAR).status == LotStatus::WAITLISTED,
+            "capacity: a retyped slot serves its new type");
+    t.check(lot.decommissionSlot(99) == LotStatus::INVALID && lot.reopenSlot(1) == LotStatus::INVALID && lot.audit().ok(),
+            "capacity: bad indices refused, audit clean");
+}
 
-        if (durationMinutes < 0) durationMinutes = 0;
-        // Round up minutes to hours, minimum 1 hour billed
-        long long hours = (durationMinutes + 59) / 60;
-        if (hours == 0) hours = 1;
-        double rate = ratePerHour_[s.type()];
-        double fee = hours * rate;
-        totalEarnings_ += fee;
+// Auditor: the checksums are order-independent toggles, the chunked audit
+// covers the whole lot, and a background auditor sweeps a lot under gate
+// churn without a false alarm
+static void selfTestAuditor(SelfTest& t) {
+    LotDigest a, b;
+    a.toggleFree(3); a.park(5000, "AUDA"); a.toggleFree(9000);
+    b.toggleFree(9000); b.toggleFree(3); b.park(5000, "AUDA");
+    bool same = a.parkedTotal() == b.parkedTotal() && a.chunks() == b.chunks();
+    for (size_t c = 0; c < a.chunks(); ++c) same = same && a.freeSum(c) == b.freeSum(c) && a.parkedSum(c) == b.parkedSum(c);
+    b.unpark(5000, "AUDA");
+    b.toggleFree(3);
+    t.check(same && b.parkedTotal() == 0 && b.freeSum(0) == 0 && b.vehicles() == 0, "auditor: checksums are order-free toggles");
 
-        Ticket t = s.releaseTicket();
-        vehicleToSlot_.erase(it);
+    ParkingLot lot;
+    lot.setVerbose(false);
+    lot.initialize(3 * LotDigest::kChunk, 0, 0);
+    mutex lotMutex;
+    atomic<int> alarms{0};
+    LotAuditor auditor;
+    auditor.start(lot, lotMutex, chrono::microseconds(200),
+                  [&alarms](size_t, const AuditReport&, const string&) { alarms.fetch_add(1); });
+    mt19937 rng(3);
+    auto until = chrono::steady_clock::now() + chrono::seconds(5);
+    for (int op = 0; auditor.passes() < 3 && chrono::steady_clock::now() < until; ++op) {
+        lock_guard<mutex> g(lotMutex);
+        string id = "AUD" + to_string(rng() % 20000);
+        if (lot.queryVehicle(id).status == LotStatus::OK) lot.vehicleExit(id, 30);
+        else lot.vehicleEntry(id, VehicleType::CAR);
+    }
+    auditor.stop();
+    t.check(!auditor.running() && auditor.passes() >= 3 && auditor.failures() == 0 && alarms.load() == 0,
+            "auditor: background sweeps under churn stay clean");
+    bool chunksOk = lot.auditChunkCount() == 3;
+    for (size_t c = 0; c < lot.auditChunkCount(); ++c) chunksOk = chunksOk && lot.auditChunk(c).ok();
+    t.check(chunksOk && lot.audit().ok(), "auditor: chunked and full audits agree");
+}
 
-        cout << fixed << setprecision(2);
-        cout << "\n🧾 Receipt\n"
-             << "  Vehicle : " << vehicleID << "\n"
-             << "  Slot    : " << (slotIdx + 1) << " (" << vehicleTypeToStr(s.type()) << ")\n"
-             << "  Duration: " << durationMinutes << " minutes (" << hours << " hour(s) billed)\n"
-             << "  Rate/hr : Rs " << rate << "\n"
-             << "  Amount  : Rs " << fee << "\n";
+// Simulator: a seed fixes the whole run, extra capacity sees the same
+// arrivals with less queueing, and a recorded trace is replayed as given
+static void selfTestSimulator(SelfTest& t) {
+    SimScenario small{"small", perVehicleType(0)}, large{"large", perVehicleType(0)};
+    for (VehicleType vt : {VehicleType::CAR, VehicleType::BIKE, VehicleType::TRUCK}) {
+        small.slots[(int)vt] = 10;
+        large.slots[(int)vt] = 200;
+    }
+    SimTraffic traffic = SimTraffic::defaults();
+    auto run = [&](uint64_t seed, const SimScenario& sc) { return LotSimulator(seed).run(sc, traffic, {}, 2 * 1440, 60, 45); };
+    SimResult a = run(42, small), b = run(42, small), c = run(43, small), d = run(42, large);
+    bool same = a.arrivals == b.arrivals && a.waitlisted == b.waitlisted && a.gaveUp == b.gaveUp && a.revenue == b.revenue
+                && a.wait.count() == b.wait.count();
+    for (int v = 0; v < kMaxVehicleClasses; ++v) same = same && a.occupiedMinutes[v] == b.occupiedMinutes[v];
+    t.check(same && a.arrivals > 0, "simulator: same seed, same run");
+    t.check(c.arrivals != a.arrivals || c.revenue != a.revenue, "simulator: another seed, another run");
+    t.check(d.arrivals == a.arrivals && d.waitlisted < a.waitlisted && a.gaveUp > 0 && d.revenue > a.revenue,
+            "simulator: more slots, same arrivals, less queueing");
 
-        // Try to allocate the freed slot to waitlist front if it matches type
-        bool assignedToWait = false;
-        if (!waitlist_.empty()) {
-            WaitEntry front = waitlist_.front();
-            if (front.type == s.type()) {
-                waitlist_.pop();
-                string newTicketID = nextTicketID();
-                Ticket nt(newTicketID, front.vehicleID, front.type, slotIdx);
-                s.assignTicket(nt);
-                vehicleToSlot_[front.vehicleID] = slotIdx;
-                totalVehiclesServed_++;
-                assignedToWait = true;
-                cout << "➡️ Freed slot " << (slotIdx + 1) << " assigned to waitlisted vehicle \""
-                     << front.vehicleID << "\" | New Ticket: " << newTicketID << "\n";
+    string path = SelfTest::scratchPath("trace.txt");
+    ofstream(path) << "# minute type dwell\n0, car, 30\n10 car 30\n20 car 5\n";
+    vector<SimArrival> trace;
+    string err;
+    bool loaded = loadSimTrace(path, trace, err);
+    SimScenario one{"one", perVehicleType(0)};
+    one.slots[(int)VehicleType::CAR] = 1;
+    SimResult r = LotSimulator(1).run(one, SimTraffic(), trace, 200, 0, 0);
+    t.check(loaded && trace.size() == 3 && r.arrivals == 3 && r.waitlisted == 2 && r.stillWaiting == 0 && r.wait.count() == 2,
+            "simulator: trace replayed");
+    ofstream(path) << "0 car 30\n5 hovercraft 10\n";
+    trace.clear();
+    t.check(!loadSimTrace(path, trace, err) && err.find(":2:") != string::npos, "simulator: bad trace line reported");
+    unlink(path.c_str());
+}
+
+// Forks and the vehicle map: writes on either side of a fork stay on that
+// side, forks churned on their own threads leave the live lot untouched,
+// and the open-addressing map agrees with a reference map under churn
+static void selfTestForks(SelfTest& t) {
+    ParkingLot lot;
+    lot.setVerbose(false);
+    lot.initialize(4, 0, 0);
+    lot.vehicleEntry("FORKA", VehicleType::CAR);
+    lot.vehicleEntry("FORKB", VehicleType::CAR);
+    unique_ptr<ParkingLot> f = lot.fork();
+    t.check(f->sharedSlotPages() > 0, "fork: slot pages shared");
+    lot.vehicleExit("FORKA", 30);
+    f->vehicleEntry("FORKC", VehicleType::CAR);
+    t.check(f->queryVehicle("FORKA").status == LotStatus::OK, "fork: keeps a vehicle the lot released");
+    t.check(lot.queryVehicle("FORKC").status == LotStatus::NOT_FOUND, "fork: entry stays in the fork");
+    t.check(lot.audit().ok() && f->audit().ok(), "fork: both audit clean");
+
+    ParkingLot live;
+    live.setVerbose(false);
+    live.initialize(5000, 0, 0);
+    for (int i = 0; i < 4000; ++i) live.vehicleEntry("LIVE" + to_string(i), VehicleType::CAR);
+    vector<unique_ptr<ParkingLot>> forks(4);
+    for (auto &fk : forks) fk = live.fork();
+    vector<int> clean(forks.size(), 0);
+    vector<thread> workers;
+    for (size_t w = 0; w < forks.size(); ++w)
+        workers.emplace_back([&, w] {
+            mt19937 rng((unsigned)w);
+            for (int op = 0; op < 3000; ++op) {
+                string id = "LIVE" + to_string(rng() % 6000);
+                if (forks[w]->queryVehicle(id).status == LotStatus::OK) forks[w]->vehicleExit(id, 30);
+                else forks[w]->vehicleEntry(id, VehicleType::CAR);
             }
-        }
-        if (!assignedToWait) {
-            // push this slot back into free heap
-            heapFor(s.type()).push(slotIdx);
-        }
+            clean[w] = forks[w]->audit().ok();
+        });
+    for (auto &th : workers) th.join();
+    bool untouched = live.metrics().occupied[(int)VehicleType::CAR].load() == 4000 && live.audit().ok();
+    for (int i = 0; i < 4000 && untouched; i += 97) untouched = live.queryVehicle("LIVE" + to_string(i)).slotIndex == i;
+    t.check(count(clean.begin(), clean.end(), 1) == (int)forks.size(), "fork: forks churned on threads audit clean");
+    t.check(untouched, "fork: live lot untouched by its forks");
+
+    VehicleMap m;
+    unordered_map<string, int> model;
+    mt19937 rng(9);
+    for (int op = 0; op < 20000; ++op) {
+        string id = "V" + to_string(rng() % 700);
+        if (rng() % 3 == 0) { m.erase(id); model.erase(id); }
+        else { m.set(id, op); model[id] = op; }
+    }
+    VehicleMap copy = m;
+    copy.set("ONLYCOPY", 1);
+    copy.erase(model.begin()->first);
+    bool agrees = m.size() == model.size() && !m.count("ONLYCOPY") && copy.size() == m.size();
+    for (int i = 0; i < 700; ++i) {
+        string id = "V" + to_string(i);
+        auto it = model.find(id);
+        agrees = agrees && m.slotOf(id) == (it == model.end() ? -1 : it->second);
     }
+    t.check(agrees, "vehicle map: agrees with a reference map; copies are isolated");
+}
 
-    // Show availability & waitlist
-    void displayAvailability() const {
-        int freeC = (int)freeCars_.size();
-        int freeB = (int)freeBikes_.size();
-        int freeT = (int)freeTrucks_.size();
-        cout << "\n📊 Availability: Free total = " << (freeC + freeB + freeT)
-             << "  (Cars: " << freeC << ", Bikes: " << freeB << ", Trucks: " << freeT << ")\n";
-
-        cout << "\n🚗 Occupied slots:\n";
-        bool any = false;
-        for (const auto &s : slots_) {
-            if (s.occupied()) {
-                any = true;
-                const Ticket &tk = s.getTicket();
-                cout << "  Slot " << (s.index()+1) << " | " << vehicleTypeToStr(s.type())
-                     << " | Vehicle: " << tk.vehicleID << " | Ticket: " << tk.id << "\n";
-            }
-        }
-        if (!any) cout << "  (none)\n";
+// Snapshots: a pinned view is frozen while the lot keeps writing, retired
+// versions are freed only once unpinned, and readers on other threads see
+// consistent versions in order while the writer publishes
+static void selfTestSnapshots(SelfTest& t) {
+    ParkingLot lot;
+    lot.setVerbose(false);
+    lot.initialize(4, 0, 0);
+    lot.vehicleEntry("SNAPA", VehicleType::CAR);
+    lot.vehicleEntry("SNAPB", VehicleType::CAR);
+    LotSnapshots snaps;
+    LotSnapshots::Reader reader = snaps.reader();
+    t.check(reader && !reader.pin(), "snapshot: empty view before the first publish");
+    snaps.publish(lot);
+    {
+        LotSnapshots::View v = reader.pin();
+        snaps.publish(lot);
+        lot.vehicleExit("SNAPB", 30);
+        snaps.publish(lot);
+        t.check(v && v.version() == 1 && v->queryVehicle("SNAPB").status == LotStatus::OK && v->statistics().exits == 0,
+                "snapshot: pinned view unchanged by later writes");
+        t.check(snaps.freed() == 0, "snapshot: nothing freed while pinned");
+    }
+    snaps.reclaim();
+    t.check(snaps.freed() == 2 && snaps.retiredPending() == 0, "snapshot: retired versions freed after unpin");
 
-        cout << "\n📋 Waitlist size: " << waitlist_.size() << "\n";
-        if (!waitlist_.empty()) {
-            queue<WaitEntry> tmp = waitlist_;
-            cout << " Front -> Back:\n";
-            int pos = 1;
-            while (!tmp.empty()) {
-                cout << "  " << pos++ << ". " << tmp.front().vehicleID << " (" << vehicleTypeToStr(tmp.front().type) << ")\n";
-                tmp.pop();
+    ParkingLot busy;
+    busy.setVerbose(false);
+    busy.initialize(500, 0, 0);
+    LotSnapshots live;
+    live.publish(busy);
+    atomic<bool> done{false};
+    vector<int> ok(3, 1);
+    vector<thread> readers;
+    for (size_t r = 0; r < ok.size(); ++r)
+        readers.emplace_back([&, r] {
+            LotSnapshots::Reader rd = live.reader();
+            uint64_t last = 0;
+            while (!done.load(memory_order_acquire)) {
+                LotSnapshots::View v = rd.pin();
+                if (!v || v.version() < last || !v->audit().ok()) ok[r] = 0;
+                if (v) last = v.version();
             }
-        }
+        });
+    mt19937 rng(4);
+    for (int op = 0; op < 3000; ++op) {
+        string id = "SNAP" + to_string(rng() % 700);
+        if (busy.queryVehicle(id).status == LotStatus::OK) busy.vehicleExit(id, 30);
+        else busy.vehicleEntry(id, VehicleType::CAR);
+        if (op % 50 == 0) live.publish(busy);
     }
+    done.store(true, memory_order_release);
+    for (auto &th : readers) th.join();
+    live.reclaim();
+    t.check(count(ok.begin(), ok.end(), 1) == (int)ok.size() && live.retiredPending() == 0 && live.freed() == live.published() - 1,
+            "snapshot: concurrent readers see consistent versions in order");
+}
 
-    // Show stats
-    void displayStats() const {
-        int occupied = 0;
-        for (const auto &s : slots_) if (s.occupied()) ++occupied;
-        int total = (int)slots_.size();
-        double occupancy = total == 0 ? 0.0 : (100.0 * occupied / total);
-        cout << fixed << setprecision(2);
-        cout << "\n=== Parking Statistics ===\n";
-        cout << "Total slots           : " << total << "\n";
-        cout << "Currently occupied    : " << occupied << "\n";
-        cout << "Occupancy percent     : " << occupancy << "%\n";
-        cout << "Total served (history): " << totalVehiclesServed_ << "\n";
-        cout << "Total earnings (Rs)   : " << totalEarnings_ << "\n";
-        cout << "Rates per hour (Rs)   : CAR=" << ratePerHour_.at(VehicleType::CAR)
-             << ", BIKE=" << ratePerHour_.at(VehicleType::BIKE)
-             << ", TRUCK=" << ratePerHour_.at(VehicleType::TRUCK) << "\n";
-    }
+// Plate search: prefix matches come first, exits leave the index, and the
+// suffix index returns the same plates as a scan of the vehicle map while
+// thousands of plates come and go
+static void selfTestPlateSearch(SelfTest& t) {
+    ParkingLot lot;
+    lot.setVerbose(false);
+    lot.initialize(10, 0, 0);
+    lot.setPlateSearch(true);
+    for (const char* p : {"DL3CAB0001", "DL3CAB0002", "HR26AB0001", "ABDL3C0009"}) lot.vehicleEntry(p, VehicleType::CAR);
+    t.check(lot.findPlates("DL3C", true).size() == 2, "plate search: prefix");
+    vector<pair<string, int>> any = lot.findPlates("DL3C");
+    t.check(any.size() == 3 && any[2].first == "ABDL3C0009" && any[0].second >= 0, "plate search: prefix matches first");
+    t.check(lot.findPlates("0001").size() == 2 && lot.findPlates("AB000").size() == 3, "plate search: suffix and fragment");
+    lot.vehicleExit("DL3CAB0001", 30);
+    t.check(lot.findPlates("DL3C", true).size() == 1, "plate search: exited plate removed");
 
-    // Print layout (1-based slot numbers for UX)
-    void printSlotsLayout() const {
-        cout << "\nSlots layout (Slot# : Type : Status)\n";
-        for (const auto &s: slots_) {
-            cout << "  " << (s.index() + 1) << " : " << vehicleTypeToStr(s.type())
-                 << " : " << (s.occupied() ? ("OCC - " + s.getTicket().vehicleID) : "FREE") << "\n";
+    ParkingLot indexed, scanned;
+    for (ParkingLot* l : {&indexed, &scanned}) {
+        l->setVerbose(false);
+        l->initialize(3000, 0, 0);
+    }
+    indexed.setPlateSearch(true);
+    mt19937 rng(21);
+    const char* states[] = {"KA", "DL", "MH", "TN"};
+    auto plateOf = [&](unsigned k) { return string(states[k % 4]) + to_string(10 + k % 13) + "AB" + to_string(1000 + k % 997); };
+    for (int op = 0; op < 8000; ++op) {
+        string p = plateOf(rng() % 4000);
+        for (ParkingLot* l : {&indexed, &scanned}) {
+            if (l->queryVehicle(p).status == LotStatus::OK) l->vehicleExit(p, 30);
+            else l->vehicleEntry(p, VehicleType::CAR);
         }
     }
-};
+    bool same = true;
+    for (const char* frag : {"KA1", "AB10", "99", "MH12AB", "7", "ZZ"}) {
+        for (bool prefix : {true, false}) {
+            auto a = indexed.findPlates(frag, prefix, 5000), b = scanned.findPlates(frag, prefix, 5000);
+            sort(a.begin(), a.end());
+            sort(b.begin(), b.end());
+            same = same && a == b;
+        }
+    }
+    t.check(same && indexed.audit().ok(), "plate search: index agrees with a scan under churn");
+}
 
-/* -------------------- Helper functions for UI -------------------- */
+// Exit matching: only a unique confusions-only match within the limit is
+// released; real edits and folded twins, even a twin beyond the limit,
+// are reported without billing anyone
+static void selfTestExitMatching(SelfTest& t) {
+    t.check(PlateMatcher::ocrDistance("KA01AB1234", "KAO1A81234") == 0.5 && PlateMatcher::ocrDistance("KA01", "KA02") == 1.0,
+            "exit match: confusions cost 0.25, other edits 1");
+    ParkingLot lot;
+    lot.setVerbose(false);
+    lot.initialize(10, 0, 0);
+    lot.setExitPlateMatching(1.0);
+    for (const char* p : {"KA01AB1234", "KA02CD5678", "MH12OB1111", "MH12DB1111"}) lot.vehicleEntry(p, VehicleType::CAR);
+    LotResult r = lot.vehicleExit("KA01A81234", 60);
+    t.check(r.status == LotStatus::PLATE_CORRECTED && r.plate == "KA01AB1234", "exit match: B/8 misread corrected");
+    r = lot.vehicleExit("KA02CD5679", 60);
+    t.check(r.status == LotStatus::AMBIGUOUS_PLATE && !r.candidates.empty() && r.candidates[0].plate == "KA02CD5678",
+            "exit match: one real edit is reported, not billed");
+    t.check(lot.queryVehicle("KA02CD5678").status == LotStatus::OK, "exit match: ambiguous plate stays parked");
+    r = lot.vehicleExit("MH120B1111", 60);
+    t.check(r.status == LotStatus::AMBIGUOUS_PLATE && r.candidates.size() >= 2, "exit match: twin folded plates are ambiguous");
+    t.check(lot.vehicleExit("KA02CD5678", 60).status == LotStatus::OK, "exit match: exact plate exits");
+    t.check(lot.vehicleExit("ZZ99ZZ9999", 60).status == LotStatus::NOT_FOUND, "exit match: unknown plate not found");
+    t.check(lot.audit().ok(), "exit match: audit");
 
-// parseType: map user input to VehicleType (case-insensitive)
-static VehicleType parseType(const string& s) {
-    string lower = s;
-    for (char &c : lower) c = tolower(c);
-    if (lower == "car" || lower == "c") return VehicleType::CAR;
-    if (lower == "bike" || lower == "b") return VehicleType::BIKE;
-    return VehicleType::TRUCK;
+    // The read is one confusion from KAO1OOOOOOOO and eight from its twin
+    ParkingLot tight;
+    tight.setVerbose(false);
+    tight.initialize(4, 0, 0);
+    tight.setExitPlateMatching(0.5);
+    tight.vehicleEntry("KA0100000000", VehicleType::CAR);
+    tight.vehicleEntry("KAO1OOOOOOOO", VehicleType::CAR);
+    r = tight.vehicleExit("KAO1OOOOOOO0", 60);
+    bool both = r.candidates.size() == 2;
+    for (const char* p : {"KA0100000000", "KAO1OOOOOOOO"})
+        both = both && any_of(r.candidates.begin(), r.candidates.end(), [p](const PlateMatcher::Candidate& c) { return c.plate == p; })
+               && tight.queryVehicle(p).status == LotStatus::OK;
+    t.check(r.status == LotStatus::AMBIGUOUS_PLATE && both, "exit match: a twin beyond the limit still blocks the release");
 }
 
-// inputPositiveInteger: robust numeric input reading for menu and minutes
-static long long inputPositiveInteger(const string &prompt) {
-    while (true) {
-        cout << prompt;
-        long long x;
-        if (!(cin >> x)) {
-            cin.clear();
-            string bad; getline(cin, bad);
-            cout << " ❗ Please enter a valid number.\n";
-            continue;
-        }
-        if (x < 0) {
-            cout << " ❗ Please enter a non-negative number.\n";
-            continue;
-        }
-        return x;
-    }
+static int runSelfTest() {
+    SelfTest t;
+    selfTestExport(t);
+    selfTestEvents(t);
+    selfTestAllocators(t);
+    selfTestMultiBay(t);
+    selfTestReservations(t);
+    selfTestForecaster(t);
+    selfTestStatistics(t);
+    selfTestMetricsServer(t);
+    selfTestGateServer(t);
+    selfTestAsync(t);
+    selfTestPromotionNotices(t);
+    selfTestVehicleTypes(t);
+    selfTestTopology(t);
+    selfTestCapacity(t);
+    selfTestAuditor(t);
+    selfTestSimulator(t);
+    selfTestForks(t);
+    selfTestSnapshots(t);
+    selfTestPlateSearch(t);
+    selfTestExitMatching(t);
+    if (t.failures) cout << "❌ Self-test: " << t.failures << " of " << t.checks << " checks failed.\n";
+    else cout << "✅ Self-test passed (" << t.checks << " checks).\n";
+    return t.failures;
 }
 
 /* -------------------- main (user-friendly menu) -------------------- */
 
-int main() {
+int main(int argc, char** argv) {
     ios::sync_with_stdio(false);
     cin.tie(nullptr);
 
+    // "--classes FILE", "--layout FILE" and "--exit-match DIST" are consumed
+    // here and may precede any mode. Without --classes, vehicle_classes.conf
+    // is used if present. --exit-match turns on misread-plate matching at
+    // exit for the console and gate-server lots: DIST bounds the candidates
+    // reported (0.5 = two O/0-style confusions, 1 = one other edit); only a
+    // unique confusions-only match is ever released.
+    string classesPath, layoutPath;
+    bool classesRequired = false;
+    double exitMatch = 0.0;
+    while (argc > 2 && (string(argv[1]) == "--classes" || string(argv[1]) == "--layout" || string(argv[1]) == "--exit-match")) {
+        if (string(argv[1]) == "--classes") {
+            classesPath = argv[2];
+            classesRequired = true;
+        } else if (string(argv[1]) == "--exit-match") {
+            exitMatch = max(0.0, atof(argv[2]));
+        } else {
+            layoutPath = argv[2];
+        }
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+    if (classesPath.empty() && ifstream("vehicle_classes.conf")) classesPath = "vehicle_classes.conf";
+    if (!classesPath.empty()) {
+        string err;
+        if (!VehicleClassRegistry::instance().loadFile(classesPath, err)) {
+            cout << "❗ Vehicle classes not loaded: " << err << "\n";
+            if (classesRequired) return 1;
+        } else {
+            cout << "✅ Loaded vehicle classes from \"" << classesPath << "\".\n";
+        }
+    }
+
+    if (argc > 1 && string(argv[1]) == "--bench") {
+        runStrategyBenchmark();
+        return 0;
+    }
+
+    if (argc > 1 && string(argv[1]) == "--simulate") return runSimulateCommand(argc - 2, argv + 2);
+
+    if (argc > 1 && string(argv[1]) == "--selftest") return runSelfTest() ? 1 : 0;
+
+    if (argc > 1 && string(argv[1]) == "--async-demo") {
+        runAsyncDemo();
+        return 0;
+    }
+
+    // --gate-server PORT [CARS BIKES TRUCKS] [--all-interfaces] : serve the binary
+    // gate protocol until Ctrl-C; on 127.0.0.1 unless --all-interfaces is given
+    if (argc > 2 && string(argv[1]) == "--gate-server") {
+        bool allInterfaces = argc > 3 && string(argv[argc - 1]) == "--all-interfaces";
+        if (allInterfaces) --argc;
+        ParkingLot gateLot;
+        gateLot.setVerbose(false);
+        gateLot.initialize(argc > 3 ? atoi(argv[3]) : 100, argc > 4 ? atoi(argv[4]) : 50, argc > 5 ? atoi(argv[5]) : 10);
+        gateLot.setExitPlateMatching(exitMatch);
+        GateServer server(gateLot);
+        if (!server.listenOn(atoi(argv[2]), allInterfaces)) {
+            cout << "❗ Could not listen on port " << argv[2] << ".\n";
+            return 1;
+        }
+        mutex lotMutex;
+        LotAuditor auditor;
+        server.setLotMutex(&lotMutex);
+        auditor.start(gateLot, lotMutex, chrono::milliseconds(2));
+
+        // Reports render from published snapshots on the metrics thread, never from gateLot
+        LotSnapshots snapshots;
+        snapshots.publish(gateLot);
+        server.setSnapshots(&snapshots, chrono::milliseconds(100));
+        LotSnapshots::Reader reportReader = snapshots.reader();
+        auto report = [&reportReader](void (ParkingLot::*show)(ostream&) const) {
+            return [&reportReader, show] {
+                ostringstream o;
+                LotSnapshots::View v = reportReader.pin();
+                o << "snapshot v" << v.version() << " @ minute " << v.takenAt() << "\n";
+                (v.lot().*show)(o);
+                return o.str();
+            };
+        };
+        MetricsServer reports;
+        reports.addPage("/availability", report(&ParkingLot::displayAvailability));
+        reports.addPage("/stats", report(&ParkingLot::displayStats));
+        if (reports.start(gateLot.metrics(), 0))
+            cout << "📊 Reports at http://127.0.0.1:" << reports.port() << "/availability, /stats and /metrics\n";
+
+        static GateServer* active = &server;
+        signal(SIGINT, [](int) { active->stop(); });
+        signal(SIGTERM, [](int) { active->stop(); });
+        cout << "🚦 Gate server listening on " << (allInterfaces ? "0.0.0.0" : "127.0.0.1") << ":" << server.port()
+             << " (Ctrl-C to stop)\n";
+        server.run();
+        reports.stop();
+        auditor.stop();
+        if (auditor.failures()) cout << "❌ Auditor reported " << auditor.failures() << " failing chunk(s).\n";
+        cout << "🗂️  Published " << snapshots.published() << " snapshot(s), " << snapshots.freed() << " reclaimed.\n";
+        cout << "👋 Gate server stopped after " << server.served() << " request(s).\n";
+        return 0;
+    }
+
+    // --gate-loadtest [PORT [CLIENTS [OPS [DEPTH]]]] : PORT 0 starts an in-process server
+    if (argc > 1 && string(argv[1]) == "--gate-loadtest") {
+        int port = argc > 2 ? atoi(argv[2]) : 0;
+        int clients = argc > 3 ? max(1, atoi(argv[3])) : 4;
+        long long ops = argc > 4 ? max(1LL, atoll(argv[4])) : 1000000;
+        int depth = argc > 5 ? max(1, atoi(argv[5])) : 128;
+        ParkingLot gateLot;
+        GateServer server(gateLot);
+        thread serverThread;
+        if (port == 0) {
+            gateLot.setVerbose(false);
+            gateLot.initialize(clients * depth, 0, 0);
+            if (!server.listenOn(0)) { cout << "❗ Could not start in-process server.\n"; return 1; }
+            port = server.port();
+            serverThread = thread([&server] { server.run(); });
+        }
+        runGateLoadTest(port, clients, ops, depth);
+        if (serverThread.joinable()) { server.stop(); serverThread.join(); }
+        return 0;
+    }
+
     ParkingLot lot;
     cout << "================ Parking Lot Management (OOP) ================\n";
-    int cars = (int)inputPositiveInteger("Number of Car slots  : ");
-    int bikes = (int)inputPositiveInteger("Number of Bike slots : ");
-    int trucks = (int)inputPositiveInteger("Number of Truck slots: ");
-    lot.initialize(cars, bikes, trucks);
+    if (layoutPath.empty() || !lot.loadLayout(layoutPath)) {
+        array<int, kMaxVehicleClasses> slotCounts = perVehicleType(0);
+        for (int t = 0; t < vehicleClassCount(); ++t) {
+            if (!ownsSlots((VehicleType)t)) continue;
+            string name = vehicleTypeToStr((VehicleType)t);
+            slotCounts[t] = (int)inputPositiveInteger("Number of " + name + " slots" + string(max(0, 6 - (int)name.size()), ' ') + ": ");
+        }
+        lot.initialize(slotCounts);
+    }
+    lot.setPlateSearch(true);
+    lot.setExitPlateMatching(exitMatch);
+    EventSubscriber console = lot.subscribe(true);
+    MetricsServer metricsServer;
 
     while (true) {
         cout << "\n----------------- Menu -----------------\n";
-        cout << "1. Vehicle Entry\n2. Vehicle Exit (enter duration)\n3. Show Availability\n4. Show Stats\n5. Print Slots Layout\n6. Set Rate per Hour\n0. Exit\nChoose: ";
+        cout << "1. Vehicle Entry\n2. Vehicle Exit (enter duration)\n3. Show Availability\n4. Show Stats\n5. Print Slots Layout\n6. Set Rate per Hour\n7. Export Lot State\n8. Show New Events\n9. Set Allocation Strategy\n10. Set Slot Fallback\n11. Reservations\n12. Occupancy Forecast\n13. Instrumentation\n14. Metrics Endpoint\n15. Vehicle Classes\n16. Garage Levels\n17. Capacity (add/close/reopen/retype)\n18. Invariant Audit\n19. What-if Scenarios\n20. Find Vehicle (partial plate)\n0. Exit\nChoose: ";
         int choice;
         if (!(cin >> choice)) {
             cin.clear();
@@ -353,8 +7001,18 @@ int main() {
         if (choice == 1) {
             string vid, typeS;
             cout << "Enter Vehicle ID: "; cin >> vid;
-            cout << "Enter Type (car/bike/truck): "; cin >> typeS;
-            lot.vehicleEntry(vid, parseType(typeS));
+            cout << "Enter Type (" << vehicleTypeChoices() << "): "; cin >> typeS;
+            const GarageTopology *topo = lot.topology();
+            if (topo && topo->gates().size() > 1) {
+                cout << "Gate (";
+                for (size_t g = 0; g < topo->gates().size(); ++g) cout << (g ? ", " : "") << g + 1 << "=" << topo->gates()[g].name;
+                long long gate = inputPositiveInteger("): ");
+                lot.vehicleEntryAt(vid, parseType(typeS), (int)gate - 1);
+            } else if (topo) {
+                lot.vehicleEntryAt(vid, parseType(typeS), 0);
+            } else {
+                lot.vehicleEntry(vid, parseType(typeS));
+            }
 
         } else if (choice == 2) {
             string vid;
@@ -373,7 +7031,7 @@ int main() {
 
         } else if (choice == 6) {
             string ts; double rate;
-            cout << "Type (car/bike/truck): "; cin >> ts;
+            cout << "Type (" << vehicleTypeChoices() << "): "; cin >> ts;
             cout << "Rate per hour (numeric): ";
             if (!(cin >> rate) || rate < 0) {
                 cin.clear(); string j; getline(cin,j);
@@ -383,6 +7041,180 @@ int main() {
                 cout << "✅ Rate set.\n";
             }
 
+        } else if (choice == 7) {
+            string fmt, path;
+            cout << "Format (csv/bin): "; cin >> fmt;
+            cout << (fmt == "csv" ? "File prefix: " : "File path: "); cin >> path;
+            if (fmt == "csv") lot.exportCSV(path);
+            else lot.exportBinary(path);
+
+        } else if (choice == 8) {
+            LotEvent ev;
+            int shown = 0;
+            cout << fixed << setprecision(2);
+            while (console.poll(ev)) {
+                ++shown;
+                cout << "  #" << ev.seq << " " << eventKindToStr(ev.kind) << " | " << vehicleTypeToStr(ev.vtype);
+                if (ev.slotIndex >= 0) cout << " | Slot#: " << (ev.slotIndex + 1);
+                if (ev.vehicleID[0]) cout << " | Vehicle: " << ev.vehicleID;
+                if (ev.kind == LotEventKind::SlotReleased) cout << " | Fee: Rs " << ev.value;
+                if (ev.kind == LotEventKind::RateChanged) cout << " | Rate: Rs " << ev.value;
+                cout << "\n";
+            }
+            if (!shown) cout << "  (no new events)\n";
+            if (console.lost()) cout << "  (" << console.lost() << " older event(s) dropped)\n";
+
+        } else if (choice == 9) {
+            for (int st = 0; st < kAllocationStrategyCount; ++st)
+                cout << "  " << st << ". " << strategyToStr((AllocationStrategy)st) << "\n";
+            long long st = inputPositiveInteger("Strategy: ");
+            if (st >= kAllocationStrategyCount) {
+                cout << " ❗ Unknown strategy. Cancelled.\n";
+            } else {
+                lot.setStrategy((AllocationStrategy)st);
+                cout << "✅ Strategy set to " << strategyToStr((AllocationStrategy)st) << ".\n";
+            }
+
+        } else if (choice == 10) {
+            string vs, ls;
+            cout << "Vehicle type (" << vehicleTypeChoices() << "): "; cin >> vs;
+            cout << "May also use slot type (same type = off): "; cin >> ls;
+            long long reserve = inputPositiveInteger("Slots of that type to keep in reserve: ");
+            lot.setFallback(parseType(vs), parseType(ls), (size_t)reserve);
+            cout << "✅ Fallback updated.\n";
+
+        } else if (choice == 11) {
+            string action;
+            cout << "Action (book/claim/cancel/list): "; cin >> action;
+            if (action == "book") {
+                string cust, ts;
+                cout << "Customer name: "; cin >> cust;
+                cout << "Type (" << vehicleTypeChoices() << "): "; cin >> ts;
+                long long in = inputPositiveInteger("Starts in how many minutes: ");
+                long long len = inputPositiveInteger("Duration in minutes: ");
+                lot.reserve(cust, parseType(ts), lot.now() + in, lot.now() + in + len);
+            } else if (action == "claim") {
+                long long id = inputPositiveInteger("Reservation number (R#): ");
+                string vid;
+                cout << "Enter Vehicle ID: "; cin >> vid;
+                lot.claimReservation(id, vid);
+            } else if (action == "cancel") {
+                lot.cancelReservation(inputPositiveInteger("Reservation number (R#): "));
+            } else {
+                lot.displayReservations();
+            }
+
+        } else if (choice == 12) {
+            long long hours = inputPositiveInteger("Hours ahead (1-24): ");
+            lot.displayForecast((int)min(24LL, max(1LL, hours)));
+
+        } else if (choice == 13) {
+            Instrumentation &ins = lot.instrumentation();
+            string action;
+            cout << "Action (on/off/trace/dump/show): "; cin >> action;
+            if (action == "on") { ins.setEnabled(true); cout << "✅ Instrumentation on.\n"; }
+            else if (action == "off") { ins.setEnabled(false); cout << "✅ Instrumentation off.\n"; }
+            else if (action == "trace") {
+                long long cap = inputPositiveInteger("Trace buffer spans (0 = stop): ");
+                ins.setTracing((size_t)cap);
+                cout << "✅ Tracing " << (cap ? "started" : "stopped") << ".\n";
+            } else if (action == "dump") {
+                string path;
+                cout << "Trace file path: "; cin >> path;
+                if (ins.dumpChromeTrace(path)) cout << "✅ Chrome trace written to \"" << path << "\".\n";
+                else cout << "❗ Could not write \"" << path << "\".\n";
+            } else {
+                ins.display();
+            }
+
+        } else if (choice == 14) {
+            if (metricsServer.running()) {
+                metricsServer.stop();
+                cout << "✅ Metrics endpoint stopped.\n";
+            } else {
+                long long port = inputPositiveInteger("Port (e.g. 9464): ");
+                if (port <= 65535 && metricsServer.start(lot.metrics(), (int)port))
+                    cout << "✅ Serving http://127.0.0.1:" << metricsServer.port() << "/metrics\n";
+                else
+                    cout << "❗ Could not listen on port " << port << ".\n";
+            }
+
+        } else if (choice == 15) {
+            VehicleClassRegistry::instance().display();
+
+        } else if (choice == 16) {
+            lot.displayLevels();
+
+        } else if (choice == 17) {
+            string action;
+            cout << "Action (add/close/reopen/retype): "; cin >> action;
+            if (action == "add") {
+                string ts;
+                cout << "Slot type (" << vehicleTypeChoices() << "): "; cin >> ts;
+                long long n = inputPositiveInteger("How many slots: ");
+                int first = lot.addSlots(parseType(ts), (int)n);
+                if (first >= 0) cout << "✅ Added slots " << (first + 1) << "-" << (first + n) << ".\n";
+                else cout << "❗ " << ts << " vehicles park in another type's slots.\n";
+            } else if (action == "close") {
+                long long from = inputPositiveInteger("First slot#: ");
+                long long to = inputPositiveInteger("Last slot#: ");
+                int n = lot.decommissionRange((int)from - 1, (int)to - 1);
+                cout << "✅ Closed " << n << " slot(s); occupied ones drain as vehicles leave.\n";
+            } else if (action == "reopen") {
+                long long from = inputPositiveInteger("First slot#: ");
+                long long to = inputPositiveInteger("Last slot#: ");
+                int n = 0;
+                for (long long i = from; i <= to; ++i) if (lot.reopenSlot((int)i - 1) == LotStatus::OK) ++n;
+                cout << "✅ Reopened " << n << " slot(s).\n";
+            } else if (action == "retype") {
+                long long idx = inputPositiveInteger("Slot#: ");
+                string ts;
+                cout << "New type (" << vehicleTypeChoices() << "): "; cin >> ts;
+                LotStatus st = lot.retypeSlot((int)idx - 1, parseType(ts));
+                if (st == LotStatus::OK) cout << "✅ Slot " << idx << " is now " << vehicleTypeToStr(parseType(ts)) << ".\n";
+                else if (st == LotStatus::DUPLICATE) cout << "❗ Slot " << idx << " is in use; close it and retype once drained.\n";
+                else cout << "❗ Invalid slot or type.\n";
+            } else {
+                cout << " ❗ Unknown action.\n";
+            }
+
+        } else if (choice == 18) {
+            lot.audit().display();
+
+        } else if (choice == 19) {
+            cout << "Scenarios, space separated (e.g. car+20 bike-10,truck+2), - for none: ";
+            string line;
+            getline(cin >> ws, line);
+            vector<SimScenario> scenarios(1);
+            scenarios[0].name = "as is";
+            istringstream specs(line == "-" ? "" : line);
+            string spec;
+            bool ok = true;
+            while (specs >> spec) {
+                SimScenario sc;
+                if (!(ok = parseSimScenario(spec, sc))) { cout << " ❗ Bad scenario \"" << spec << "\" (want e.g. bike+200).\n"; break; }
+                scenarios.push_back(sc);
+            }
+            if (ok) {
+                long long hours = inputPositiveInteger("Hours ahead: ");
+                runWhatIf(lot, scenarios, SimTraffic::defaults(), (double)hours, 30, 1, 4);
+            }
+
+        } else if (choice == 20) {
+            string fragment;
+            cout << "Plate fragment (^KA01 = starts with KA01): "; cin >> fragment;
+            bool prefixOnly = fragment.size() > 1 && fragment[0] == '^';
+            if (prefixOnly) fragment.erase(0, 1);
+            const size_t shown = 20;
+            auto found = lot.findPlates(fragment, prefixOnly, shown);
+            if (found.empty()) {
+                cout << "🔎 No parked vehicle matches \"" << fragment << "\".\n";
+                for (const auto &m : lot.matchPlates(fragment, 1.0))
+                    cout << "  Did you mean " << m.plate << "? (OCR distance " << m.distance << ")\n";
+            }
+            for (const auto &f : found) cout << "  Slot " << (f.second + 1) << " | Vehicle: " << f.first << "\n";
+            if (found.size() == shown) cout << "  (first " << shown << " shown; type more of the plate to narrow it)\n";
+
         } else {
             cout << " ❗ Invalid choice. Try again.\n";
         }